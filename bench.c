@@ -0,0 +1,462 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <rte_cycles.h>
+#include <rte_eth_ring.h>
+#include <rte_ethdev.h>
+#include <rte_launch.h>
+#include <rte_ring.h>
+
+#include <lwip/udp.h>
+#include <netif/etharp.h>
+
+#include "bench.h"
+#include "bridge.h"
+#include "dispatch.h"
+#include "gen.h"
+#include "main.h"
+#include "mempool.h"
+#include "replay.h"
+#include "stats.h"
+
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION		"unknown"
+#endif
+
+#define BENCH_RING_SIZE		1024
+#define BENCH_RING_PORT_MAX	8
+
+struct bench_ring_port {
+	uint8_t			 port_id;
+	struct rte_ring		*rx;	/* the generator enqueues here */
+	struct rte_ring		*tx;	/* and drains here */
+};
+
+static struct bench {
+	struct bench_conf	 conf;
+	struct bench_ring_port	 rings[BENCH_RING_PORT_MAX];
+	int			 nr_rings;
+	int			 ingress;
+	unsigned		 lcore_id;	/* of the generator */
+	struct net_port		*ports;
+	struct rte_mempool	*pool;
+	struct gen		 gen;
+	struct replay		 replay;
+	struct udp_pcb		*sink;
+	uint64_t		 sink_pkts;
+	uint64_t		 sink_bytes;
+	uint64_t		 offered;	/* taken by the ingress ring */
+	uint64_t		 in_pkts;	/* received by the dispatch */
+	uint64_t		 out_pkts;
+	uint64_t		 out_bytes;
+	uint64_t		 tsc;
+} bench;
+
+static const char *bench_names[] = {
+	[BENCH_NONE]	    = "none",
+	[BENCH_UDP]	    = "udp",
+	[BENCH_FLOOD]	    = "flood",
+	[BENCH_VXLAN_ENCAP] = "vxlan_encap",
+	[BENCH_VXLAN_DECAP] = "vxlan_decap",
+	[BENCH_FORWARD]	    = "forward",
+};
+
+int
+bench_parse_scenario(struct bench_conf *conf, const char *name)
+{
+	int i;
+
+	for (i = BENCH_UDP; i <= BENCH_FORWARD; i++) {
+		if (!strcmp(name, bench_names[i])) {
+			conf->scenario = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int
+bench_ring_port(struct net_port *net_port, const char *addr,
+		const char *netmask)
+{
+	struct bench_ring_port *r;
+	char name[RTE_RING_NAMESIZE];
+	int ret;
+
+	if (bench.nr_rings >= BENCH_RING_PORT_MAX)
+		return -1;
+
+	r = &bench.rings[bench.nr_rings];
+
+	snprintf(name, sizeof(name), "bench_rx%d", bench.nr_rings);
+	r->rx = rte_ring_create(name, BENCH_RING_SIZE, rte_socket_id(),
+				RING_F_SP_ENQ | RING_F_SC_DEQ);
+	snprintf(name, sizeof(name), "bench_tx%d", bench.nr_rings);
+	r->tx = rte_ring_create(name, BENCH_RING_SIZE, rte_socket_id(),
+				RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (r->rx == NULL || r->tx == NULL) {
+		RTE_LOG(ERR, APP, "Cannot create bench rings\n");
+		return -1;
+	}
+
+	snprintf(name, sizeof(name), "bench%d", bench.nr_rings);
+	ret = rte_eth_from_rings(name, &r->rx, 1, &r->tx, 1, rte_socket_id());
+	if (ret < 0) {
+		RTE_LOG(ERR, APP, "Cannot create ring eth device\n");
+		return -1;
+	}
+	r->port_id = ret;
+
+	memset(net_port, 0, sizeof(*net_port));
+	net_port->rte_port_type = RTE_PORT_TYPE_ETH;
+	net_port->net.port_id = r->port_id;
+	if (addr) {
+		ipaddr_aton(addr, &net_port->net.ip_addr);
+		ipaddr_aton(netmask, &net_port->net.netmask);
+	}
+
+	return bench.nr_rings++;
+}
+
+/*
+ * Creates the ring backed eth devices of the scenario and sets up their
+ * ports, before the ports are created as usual.
+ */
+int
+bench_setup(struct bench_conf *conf, struct net_port *ports,
+	    int nr_ports_max)
+{
+	struct vxlan_peer peer;
+	uint32_t i, nr;
+
+	bench.conf = *conf;
+	bench.ports = ports;
+
+	switch (conf->scenario) {
+	case BENCH_UDP:
+		nr = 1;
+		break;
+	case BENCH_FLOOD:
+		nr = conf->nr_ports;
+		break;
+	default:
+		nr = 2;
+	}
+	if (nr > nr_ports_max || nr > BENCH_RING_PORT_MAX)
+		return -1;
+
+	for (i = 0; i < nr; i++) {
+		const char *addr = NULL, *netmask = "255.255.255.0";
+
+		switch (conf->scenario) {
+		case BENCH_UDP:
+			addr = "10.0.0.1";
+			break;
+		case BENCH_VXLAN_ENCAP:
+		case BENCH_VXLAN_DECAP:
+			/* eth0 is bridged, eth1 is the underlay */
+			addr = i ? "10.0.0.1" : NULL;
+			break;
+		case BENCH_FORWARD:
+			addr = i ? "10.0.1.1" : "10.0.0.1";
+			break;
+		default:
+			break;
+		}
+
+		if (bench_ring_port(&ports[i], addr, netmask) < 0)
+			return -1;
+	}
+
+	if (conf->scenario == BENCH_VXLAN_ENCAP ||
+	    conf->scenario == BENCH_VXLAN_DECAP) {
+		BR0.plug.net_port.rte_port_type = RTE_PORT_TYPE_PLUG;
+
+		for (i = 0; i < conf->nr_peers; i++) {
+			memset(&peer, 0, sizeof(peer));
+			IP4_ADDR(&peer.ip_addr, 10, 0, 0, 2 + i);
+			if (bridge_add_vxlan(&BR0, &peer) != 0)
+				return -1;
+		}
+	}
+
+	bench.ingress = conf->scenario == BENCH_VXLAN_DECAP ? 1 : 0;
+
+	return nr;
+}
+
+static void
+bench_sink_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
+		ip_addr_t *addr, u16_t port)
+{
+	bench.sink_pkts++;
+	bench.sink_bytes += p->tot_len;
+	pbuf_free(p);
+}
+
+static void
+bench_static_arp(ip_addr_t *ip_addr, uint8_t last)
+{
+	struct eth_addr mac = {{ 0x02, 0x00, 0x00, 0x00, 0x01, last }};
+
+	etharp_add_static_entry(ip_addr, &mac);
+}
+
+static void
+bench_drain(void)
+{
+	struct rte_mbuf *pkts[PKT_BURST_SZ];
+	unsigned i, j, n;
+
+	for (i = 0; i < bench.nr_rings; i++) {
+		if (i == bench.ingress)
+			continue;
+
+		n = rte_ring_sc_dequeue_burst(bench.rings[i].tx,
+					      (void **)pkts, PKT_BURST_SZ);
+		for (j = 0; j < n; j++) {
+			bench.out_bytes += rte_pktmbuf_pkt_len(pkts[j]) +
+				GEN_CRC_LEN;
+			rte_pktmbuf_free(pkts[j]);
+		}
+		bench.out_pkts += n;
+	}
+}
+
+/* Runs on its own lcore, offering as much as the ingress ring takes */
+static int
+bench_gen(void *arg)
+{
+	struct rte_port *ingress = bench.ports[bench.ingress].rte_port;
+	struct rte_ring *rx = bench.rings[bench.ingress].rx;
+	struct rte_mbuf *pkts[PKT_BURST_SZ];
+	struct rte_port_stats s0, s1;
+	uint64_t start, end, now;
+	unsigned i, n, sent;
+
+	stats_port_sum(ingress->stats_id, &s0);
+	start = rte_rdtsc();
+	end = start + rte_get_tsc_hz() * bench.conf.secs;
+
+	while ((now = rte_rdtsc()) < end) {
+		if (bench.conf.replay_path)
+			n = replay_burst(&bench.replay, bench.pool, pkts,
+					 PKT_BURST_SZ, now);
+		else
+			n = gen_burst(&bench.gen, pkts, PKT_BURST_SZ);
+		sent = rte_ring_sp_enqueue_burst(rx, (void **)pkts, n);
+		for (i = sent; i < n; i++)
+			rte_pktmbuf_free(pkts[i]);
+		bench.offered += sent;
+
+		bench_drain();
+	}
+
+	stats_port_sum(ingress->stats_id, &s1);
+	bench.tsc = now - start;
+	bench.in_pkts = s1.rx_packets - s0.rx_packets;
+
+	dispatch_quit = 1;
+
+	return 0;
+}
+
+int
+bench_start(void)
+{
+	struct gen_conf conf;
+	struct net_port *ingress = &bench.ports[bench.ingress];
+	struct ether_addr mac;
+	ip_addr_t ip_addr;
+	unsigned lcore_id;
+	uint32_t i;
+
+	lcore_id = spare_lcore();
+	if (lcore_id >= RTE_MAX_LCORE) {
+		RTE_LOG(ERR, APP, "No spare lcore for the generator\n");
+		return -1;
+	}
+
+	bench.pool = rte_mempool_create(
+		"bench_pool", mempool_conf.nb_mbuf,
+		MEMPOOL_MBUF_SZ(mempool_conf.data_room),
+		mempool_conf.cache_size,
+		sizeof(struct rte_pktmbuf_pool_private),
+		rte_pktmbuf_pool_init, NULL, rte_pktmbuf_init, NULL,
+		rte_socket_id(), 0);
+	if (bench.pool == NULL) {
+		RTE_LOG(ERR, APP, "Cannot create bench pool\n");
+		return -1;
+	}
+
+	rte_eth_macaddr_get(ingress->net.port_id, &mac);
+
+	memset(&conf, 0, sizeof(conf));
+	conf.mix = bench.conf.mix;
+	conf.src_mac = (struct ether_addr) {{ 0x02, 0, 0, 0, 0, 0x01 }};
+	conf.dst_mac = mac;
+	conf.src_ip = rte_cpu_to_be_32(IPv4(10, 0, 0, 2));
+	conf.dst_ip = rte_cpu_to_be_32(IPv4(10, 0, 0, 1));
+	conf.src_port = 1024;
+	conf.dst_port = BENCH_UDP_PORT;
+	/* the VXLAN frames of a mix are sent to the ingress port */
+	conf.outer_src_mac = conf.src_mac;
+	conf.outer_dst_mac = mac;
+	conf.outer_src_ip = conf.src_ip;
+	conf.outer_dst_ip = conf.dst_ip;
+
+	switch (bench.conf.scenario) {
+	case BENCH_UDP:
+		bench.sink = udp_new();
+		if (bench.sink == NULL ||
+		    udp_bind(bench.sink, IP_ADDR_ANY, BENCH_UDP_PORT) != ERR_OK)
+			return -1;
+		udp_recv(bench.sink, bench_sink_recv, NULL);
+		break;
+	case BENCH_FLOOD:
+		conf.dst_mac = (struct ether_addr) {{ 0x02, 0, 0, 0, 0, 0x02 }};
+		break;
+	case BENCH_VXLAN_ENCAP:
+		conf.dst_mac = (struct ether_addr) {{ 0x02, 0, 0, 0, 0, 0x02 }};
+		for (i = 0; i < bridge_nr_peers(&BR0); i++)
+			bench_static_arp(&BR0.vxlan.peers->peers[i].ip_addr,
+					 i);
+		break;
+	case BENCH_VXLAN_DECAP:
+		conf.mix.arp_pct = conf.mix.bcast_pct = 0;
+		conf.mix.vxlan_pct = 100;
+		conf.dst_mac = (struct ether_addr) {{ 0x02, 0, 0, 0, 0, 0x02 }};
+		break;
+	case BENCH_FORWARD:
+		conf.dst_ip = rte_cpu_to_be_32(IPv4(10, 0, 1, 2));
+		IP4_ADDR(&ip_addr, 10, 0, 1, 2);
+		bench_static_arp(&ip_addr, 0);
+		break;
+	default:
+		return -1;
+	}
+
+	if (bench.conf.replay_path) {
+		if (replay_load(&bench.replay, bench.conf.replay_path,
+				bench.conf.speed, rte_socket_id()) != 0)
+			return -1;
+	} else if (gen_init(&bench.gen, &conf, bench.pool,
+			    rte_socket_id()) != 0) {
+		RTE_LOG(ERR, APP, "Cannot init the generator\n");
+		return -1;
+	}
+
+	if (rte_eal_remote_launch(bench_gen, NULL, lcore_id) != 0) {
+		RTE_LOG(ERR, APP, "Cannot launch the generator\n");
+		return -1;
+	}
+	bench.lcore_id = lcore_id;
+
+	return 0;
+}
+
+/* One JSON object per run, to be collected across versions */
+void
+bench_report(FILE *f)
+{
+	struct gen_mix *mix = &bench.gen.conf.mix;
+	struct rte_port_stats sum;
+	struct cycles_stats c;
+	uint64_t rx_dropped = 0, tx_dropped = 0, out_pkts, out_bytes;
+	uint64_t pkts, bytes;
+	double secs;
+	uint32_t id, frame_size;
+	int stage;
+
+	rte_eal_wait_lcore(bench.lcore_id);
+
+	for (id = 0; id < stats_shm->nr_ports; id++) {
+		stats_port_sum(id, &sum);
+		rx_dropped += sum.rx_dropped;
+		tx_dropped += sum.tx_dropped;
+	}
+
+	if (bench.conf.scenario == BENCH_UDP) {
+		out_pkts = bench.sink_pkts;
+		out_bytes = bench.sink_bytes;
+	} else {
+		out_pkts = bench.out_pkts;
+		out_bytes = bench.out_bytes;
+	}
+
+	secs = (double)bench.tsc / rte_get_tsc_hz();
+
+	/* the mean with a mix of sizes, as on the wire */
+	if (bench.conf.replay_path) {
+		pkts = bench.replay.pkts;
+		bytes = bench.replay.bytes;
+	} else {
+		pkts = bench.gen.pkts;
+		bytes = bench.gen.bytes;
+	}
+	frame_size = pkts ? bytes / pkts + GEN_CRC_LEN : 0;
+
+	fprintf(f, "{\"version\":\"%s\",\"scenario\":\"%s\","
+		"\"replay\":\"%s\",\"speed\":%u,"
+		"\"frame_size\":%u,\"flows\":%u,\"arp_pct\":%u,"
+		"\"bcast_pct\":%u,\"vxlan_pct\":%u,\"ports\":%d,\"peers\":%d,"
+		"\"secs\":%.3f,\"offered_mpps\":%.3f,\"rx_mpps\":%.3f,"
+		"\"out_mpps\":%.3f,\"out_gbps\":%.3f,\"cycles_per_pkt\":%.1f,"
+		"\"rx_dropped\":%"PRIu64",\"tx_dropped\":%"PRIu64,
+		PACKAGE_VERSION, bench_names[bench.conf.scenario],
+		bench.conf.replay_path ? bench.conf.replay_path : "",
+		bench.conf.speed,
+		frame_size, mix->nr_flows, mix->arp_pct, mix->bcast_pct,
+		mix->vxlan_pct, bench.nr_rings, bridge_nr_peers(&BR0), secs,
+		bench.offered / secs / 1e6, bench.in_pkts / secs / 1e6,
+		out_pkts / secs / 1e6, out_bytes * 8 / secs / 1e9,
+		bench.in_pkts ? (double)bench.tsc / bench.in_pkts : 0.0,
+		rx_dropped, tx_dropped);
+
+	/* per received packet, all 0 unless built with --enable-cycles */
+	fprintf(f, ",\"stage_cycles\":{");
+	for (stage = 0; stage < CYCLES_STAGE_MAX; stage++) {
+		stats_cycles_sum(stage, &c);
+		fprintf(f, "%s\"%s\":%.1f", stage ? "," : "",
+			cycles_stage_names[stage],
+			bench.in_pkts ? (double)c.cycles / bench.in_pkts : 0.0);
+	}
+	fprintf(f, "}}\n");
+	fflush(f);
+}
@@ -0,0 +1,74 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gen.h"
+#include "port.h"
+
+#define BENCH_SECS_DEFAULT	5
+#define BENCH_PORTS_DEFAULT	3
+#define BENCH_PEERS_DEFAULT	2
+
+/* UDP port of the lwIP sink */
+#define BENCH_UDP_PORT		9
+
+typedef enum {
+	BENCH_NONE = 0,
+	BENCH_UDP,		/* eth -> lwIP UDP */
+	BENCH_FLOOD,		/* eth -> bridge flood to N ports */
+	BENCH_VXLAN_ENCAP,	/* eth -> bridge -> VXLAN to N peers */
+	BENCH_VXLAN_DECAP,	/* VXLAN -> bridge -> eth */
+	BENCH_FORWARD,		/* eth -> lwIP IP forward -> eth */
+} bench_scenario;
+
+struct bench_conf {
+	bench_scenario	 scenario;
+	struct gen_mix	 mix;
+	uint32_t	 nr_ports;	/* BENCH_FLOOD */
+	uint32_t	 nr_peers;	/* BENCH_VXLAN_* */
+	uint32_t	 secs;
+	char		*replay_path;	/* instead of the generator */
+	uint32_t	 speed;		/* of the replay, in percent */
+};
+
+int bench_parse_scenario(struct bench_conf *conf, const char *name);
+int bench_setup(struct bench_conf *conf, struct net_port *ports,
+		int nr_ports_max);
+int bench_start(void);
+void bench_report(FILE *f);
+
+#endif
@@ -36,31 +36,98 @@
 
 #include <rte_byteorder.h>
 #include <rte_debug.h>
+#include <rte_malloc.h>
 #include <rte_memcpy.h>
 
 #include "bridge.h"
 #include "plugif.h"
 #include "mempool.h"
+#include "rcu.h"
+#include "stats.h"
 
 struct bridge BR0;
 
+static struct bridge_table *
+bridge_table_copy(struct bridge *bridge)
+{
+	struct bridge_table *table;
+
+	table = rte_zmalloc("BRIDGE", sizeof(*table), CACHE_LINE_SIZE);
+	if (table == NULL) {
+		RTE_LOG(ERR, APP, "Cannot allocate bridge table\n");
+		return NULL;
+	}
+	if (bridge->table)
+		*table = *bridge->table;
+	return table;
+}
+
 int
 bridge_add_port(struct bridge *bridge, struct net_port *net_port)
 {
+	struct bridge_table *table;
+	struct bridge_port *port = NULL;
+	int i;
+
 	RTE_VERIFY(net_port->rte_port_type == RTE_PORT_TYPE_PLUG ||
 		   !net_port->netif);
 
-	if (bridge->nr_ports >= BRIDGE_PORT_MAX)
+	/* a slot is free again once its port left the bridge */
+	for (i = 0; i < BRIDGE_PORT_MAX; i++) {
+		if (bridge->ports[i].net_port == NULL) {
+			port = &bridge->ports[i];
+			break;
+		}
+	}
+	if (port == NULL)
 		return -1;
 
-	bridge->ports[bridge->nr_ports] = (struct bridge_port) {
-		.port_id = bridge->nr_ports,
+	table = bridge_table_copy(bridge);
+	if (table == NULL)
+		return -1;
+
+	*port = (struct bridge_port) {
+		.port_id = i,
 		.bridge = bridge,
 		.net_port = net_port,
 	};
-	net_port->bridge_port = &bridge->ports[bridge->nr_ports];
+	net_port->bridge_port = port;
+	table->ports[table->nr_ports++] = port;
+
+	rcu_free(bridge->table);
+	rcu_assign(bridge->table, table);
+
+	return 0;
+}
+
+/* The slot is released at once, as the bridge only runs on the
+ * dispatch lcore that calls this.
+ */
+int
+bridge_del_port(struct bridge *bridge, struct net_port *net_port)
+{
+	struct bridge_port *port = net_port->bridge_port;
+	struct bridge_table *table;
+	int i, n = 0;
+
+	if (port == NULL || port->bridge != bridge)
+		return -1;
+
+	table = bridge_table_copy(bridge);
+	if (table == NULL)
+		return -1;
+
+	for (i = 0; i < table->nr_ports; i++) {
+		if (table->ports[i] != port)
+			table->ports[n++] = table->ports[i];
+	}
+	table->nr_ports = n;
+
+	rcu_free(bridge->table);
+	rcu_assign(bridge->table, table);
 
-	bridge->nr_ports++;
+	net_port->bridge_port = NULL;
+	port->net_port = NULL;
 
 	return 0;
 }
@@ -80,83 +147,123 @@ bridge_add_plug(struct bridge *bridge, struct net_port *net_port,
 	return  0;
 }
 
+static struct vxlan_peers *
+vxlan_peers_copy(struct vxlan *vxlan)
+{
+	struct vxlan_peers *peers;
+
+	peers = rte_zmalloc("VXLAN", sizeof(*peers), CACHE_LINE_SIZE);
+	if (peers == NULL) {
+		RTE_LOG(ERR, APP, "Cannot allocate VXLAN peers\n");
+		return NULL;
+	}
+	if (vxlan->peers)
+		*peers = *vxlan->peers;
+	return peers;
+}
+
 int
 bridge_add_vxlan(struct bridge *bridge, struct vxlan_peer *peer)
 {
-	struct udp_pcb *pcb;
+	struct vxlan *vxlan = &bridge->vxlan;
+	struct vxlan_peers *peers;
+	struct vxlan_peer *p;
+
+	if (bridge_nr_peers(bridge) >= VXLAN_DST_MAX)
+		return -1;
 
-	if (bridge->vxlan.nr_peers >= VXLAN_DST_MAX)
+	peers = vxlan_peers_copy(vxlan);
+	if (peers == NULL)
 		return -1;
 
-	pcb = udp_new();
-	if (!pcb)
+	p = &peers->peers[peers->nr_peers++];
+	ip_addr_copy(p->ip_addr, peer->ip_addr);
+	p->port = peer->port ? peer->port : VXLAN_DST_PORT;
+
+	rcu_free(vxlan->peers);
+	rcu_assign(vxlan->peers, peers);
+
+	return 0;
+}
+
+int
+bridge_del_vxlan(struct bridge *bridge, struct vxlan_peer *peer)
+{
+	struct vxlan *vxlan = &bridge->vxlan;
+	struct vxlan_peers *peers;
+	struct vxlan_peer *p;
+	u16_t port = peer->port ? peer->port : VXLAN_DST_PORT;
+	int i, n = 0;
+
+	peers = vxlan_peers_copy(vxlan);
+	if (peers == NULL)
 		return -1;
 
-	if (udp_connect(pcb, &peer->ip_addr, peer->port) != ERR_OK) {
-		udp_remove(pcb);
+	for (i = 0; i < peers->nr_peers; i++) {
+		p = &peers->peers[i];
+		if (ip_addr_cmp(&p->ip_addr, &peer->ip_addr) &&
+		    p->port == port)
+			continue;
+		peers->peers[n++] = *p;
+	}
+	if (n == peers->nr_peers) {
+		rte_free(peers);
 		return -1;
 	}
+	peers->nr_peers = n;
 
-	bridge->vxlan.peers[bridge->vxlan.nr_peers++] = pcb;
+	rcu_free(vxlan->peers);
+	rcu_assign(vxlan->peers, peers);
 
 	return 0;
 }
 
+int
+bridge_nr_peers(struct bridge *bridge)
+{
+	struct vxlan_peers *peers = rcu_dereference(bridge->vxlan.peers);
+
+	return peers ? peers->nr_peers : 0;
+}
+
+/* buffer ownership and responsivity [recv]
+ *   mbuf: transfer the ownership of all decapsulated mbuf to the bridge,
+ *         otherwise free all here
+ */
 static void
-vxlan_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p,
-	   ip_addr_t *addr, u16_t port)
+vxlan_recv(void *arg, struct udp_mbuf_sock *sock,
+	   struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct bridge *bridge = (struct bridge *)arg;
 	struct rte_port *rte_port = bridge->plug.net_port.rte_port;
 	struct rte_port_plug *plug =
 		container_of(rte_port, struct rte_port_plug, rte_port);
 	struct rte_mbuf *m;
-	struct pbuf *q;
-
-	m = rte_pktmbuf_alloc(pktmbuf_pool);
-	if (m == NULL)
-		goto free_pbuf;
+	uint32_t i, n = 0;
 
-	if (pbuf_header(p, -(int)(sizeof(struct vxlanhdr))) != 0)
-		goto free_mbuf;
-
-	for(q = p; q != NULL; q = q->next) {
-		char *data = rte_pktmbuf_append(m, q->len);
-		if (data == NULL)
-			goto free_mbuf;
-		rte_memcpy(data, q->payload, q->len);
+	for (i = 0; i < n_pkts; i++) {
+		m = pkts[i];
+		if (vxlan_decap(m) != 0) {
+			rte_pktmbuf_free(m);
+			continue;
+		}
+		pkts[n++] = m;
 	}
 
-	bridge_rx_burst(plug, &m, 1);
-
-	goto free_pbuf;
-
-free_mbuf:
-	rte_pktmbuf_free(m);
-
-free_pbuf:
-	pbuf_free(p);
+	if (n > 0)
+		bridge_rx_burst(plug, pkts, n);
 }
 
 int
 bridge_bind_vxlan(struct bridge *bridge)
 {
-	struct udp_pcb *pcb;
-	err_t ret;
+	struct udp_mbuf_sock *sock;
 
-	pcb = udp_new();
-	if (!pcb)
+	sock = udp_mbuf_open(IP_ADDR_ANY, VXLAN_DST_PORT, vxlan_recv, bridge);
+	if (!sock)
 		return ERR_MEM;
 
-	ret = udp_bind(pcb, IP_ADDR_ANY, VXLAN_DST_PORT);
-	if (ret != ERR_OK) {
-		udp_remove(pcb);
-		return ret;
-	}
-
-	udp_recv(pcb, vxlan_recv, bridge);
-
-	bridge->vxlan.local = pcb;
+	bridge->vxlan.sock = sock;
 
 	return ERR_OK;
 }
@@ -165,39 +272,52 @@ static int
 bridge_flood(struct bridge *bridge, struct bridge_port *ingress,
 	     struct rte_mbuf **pkts, int n_pkts)
 {
+	struct bridge_table *table = rcu_dereference(bridge->table);
 	struct net_port *net_port;
 	struct rte_port *rte_port;
 	struct rte_mbuf *pkts_clone[n_pkts], *clone;
-	int egress;
-	int i, j, k;
+	int last;
+	int i, j;
 
-	if (bridge->nr_ports <= 1) {
+	if (table == NULL || table->nr_ports <= 1) {
 		for (j = 0; j < n_pkts; j++)
 			rte_pktmbuf_free(pkts[j]);
+		rte_port_drop(ingress->net_port->rte_port, DROP_RX_NO_EGRESS,
+			      n_pkts);
 		return 0;
 	}
 
-	for (i = 1; i < bridge->nr_ports; i++) {
-		egress = (ingress->port_id + i) % bridge->nr_ports;
-		net_port = bridge->ports[egress].net_port;
+	trace(TRACE_FLOOD, table->nr_ports - 1,
+	      ingress->net_port->rte_port->stats_id, n_pkts);
+
+	/* the last egress port gets the packets, the others clones */
+	last = table->nr_ports - 1;
+	if (table->ports[last] == ingress)
+		last--;
+
+	for (i = 0; i <= last; i++) {
+		if (table->ports[i] == ingress)
+			continue;
+		net_port = table->ports[i]->net_port;
 		rte_port = net_port->rte_port;
 
-		if (i >= (bridge->nr_ports - 1)) {
+		if (i == last) {
 			rte_port->ops.tx_burst(rte_port, pkts, n_pkts);
 			break;
 		}
 
 		for (j = 0; j < n_pkts; j++) {
-			clone = rte_pktmbuf_clone(pkts[j], pktmbuf_pool);
-			if (!clone) {
-				for (k = 0; k < j; k++)
-					rte_pktmbuf_free(pkts_clone[k]);
-				return -1;
-			}
+			clone = mempool_clone(pkts[j], indirect_pool);
+			if (!clone)
+				break;
 			pkts_clone[j] = clone;
 		}
 
-		rte_port->ops.tx_burst(rte_port, pkts_clone, n_pkts);
+		/* the port misses the packets that could not be cloned */
+		if (j < n_pkts)
+			rte_port_drop(rte_port, DROP_TX_CLONE, n_pkts - j);
+		if (j > 0)
+			rte_port->ops.tx_burst(rte_port, pkts_clone, j);
 	}
 	return 0;
 }
@@ -206,8 +326,10 @@ int
 bridge_input(struct bridge *bridge, struct bridge_port *ingress,
 	     struct rte_mbuf **pkts, int n_pkts)
 {
+	CYCLES_BEGIN(tsc);
 	if (bridge_flood(bridge, ingress, pkts, n_pkts) != 0)
 		return 0;
+	CYCLES_END(CYCLES_BRIDGE, tsc, n_pkts);
 
 	return n_pkts;
 }
@@ -223,8 +345,8 @@ bridge_rx_burst(struct rte_port_plug *plug_port,
 }
 
 /* buffer ownership and responsivity [tx_burst]
- *   mbuf: transfer the ownership of all mbuf sent successfully to
- *         the underlying device, otherwise free all here
+ *   mbuf: transfer the ownership of all mbuf to plugif_input, which
+ *         frees them even on failure
  */
 int
 bridge_tx_burst(struct rte_port_plug *plug_port,
@@ -232,83 +354,80 @@ bridge_tx_burst(struct rte_port_plug *plug_port,
 {
 	struct bridge *bridge = (struct bridge *)plug_port->private_data;
 	struct plugif *plugif = bridge->plug.plugif;
-	uint32_t i, j;
+	uint32_t i;
 
 	for (i = 0; i < n_pkts; i++) {
-		if (plugif_input(plugif, pkts[i]) != ERR_OK) {
-			for (j = i + 1; j < n_pkts; j++)
-				rte_pktmbuf_free(pkts[j]);
-			plug_port->rte_port.stats.rx_dropped += n_pkts - i;
-			return i;
-		}
+		if (plugif_input(plugif, pkts[i]) != ERR_OK)
+			rte_port_drop(&plug_port->rte_port, DROP_TX_LWIP, 1);
 	}
 	return n_pkts;
 }
 
-/* buffer ownership and responsivity [udp_send]
- *   pbuf: free a newly allocated pbuf here
- *   mbuf: free all here
- */
-static err_t
-bridge_tx_vxlan(struct bridge *bridge, struct rte_mbuf *m)
-{
-	struct vxlanhdr *header;
-	struct pbuf *p, *q;
-	err_t ret;
-	int len, i;
-	char *dat;
-
-	header = (struct vxlanhdr *)rte_pktmbuf_prepend(m, sizeof(*header));
-	if (!header)
-		return ERR_MEM;
-
-	header->vx_flags = rte_cpu_to_be_32(0x08000000);
-	header->vx_vni =  rte_cpu_to_be_32(0x100);
-
-	len = rte_pktmbuf_pkt_len(m);
-	dat = rte_pktmbuf_mtod(m, char *);
-
-	for (i = 0; i < bridge->vxlan.nr_peers; i++) {
-		p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-		if (p == 0) {
-			rte_pktmbuf_free(m);
-			return ERR_MEM;
-		}
-
-		for(q = p; q != NULL; q = q->next) {
-			rte_memcpy(q->payload, dat, q->len);
-			dat += q->len;
-		}
-		ret = udp_send(bridge->vxlan.peers[i], p);
-		pbuf_free(p);
-		if (ret != ERR_OK) {
-			rte_pktmbuf_free(m);
-			return ret;
-		}
-	}
-
-	rte_pktmbuf_free(m);
-	return ERR_OK;
-}
-
 /* buffer ownership and responsivity [tx_burst]
- *   mbuf: transfer the ownership of all mbuf sent successfully to
- *         the underlying device, otherwise free all here
+ *   mbuf: transfer the ownership of all mbuf to the VXLAN peers; the
+ *         payload is shared between peers through indirect mbufs
  */
 int
 bridge_tx_vxlan_burst(struct rte_port_plug *plug_port,
 		      struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct bridge *bridge = (struct bridge *)plug_port->private_data;
-	uint32_t i, j;
+	struct vxlan *vxlan = &bridge->vxlan;
+	struct vxlan_peers *peers = rcu_dereference(vxlan->peers);
+	struct rte_mbuf *pkts_clone[n_pkts], *clone;
+	struct vxlan_peer *peer;
+	struct rte_port *rte_port = &plug_port->rte_port;
+	uint32_t i, j, n = 0;
+	int sent;
+
+	CYCLES_BEGIN(tsc);
+
+	if (!vxlan->sock || !peers || peers->nr_peers == 0) {
+		for (i = 0; i < n_pkts; i++)
+			rte_pktmbuf_free(pkts[i]);
+		rte_port_drop(rte_port, DROP_TX_VXLAN, n_pkts);
+		return n_pkts;
+	}
 
 	for (i = 0; i < n_pkts; i++) {
-		if (bridge_tx_vxlan(bridge, pkts[i]) != ERR_OK) {
-			for (j = i + 1; j < n_pkts; j++)
-				rte_pktmbuf_free(pkts[j]);
-			plug_port->rte_port.stats.rx_dropped += n_pkts - i;
-			return i;
+		if (vxlan_encap(pkts[i]) != 0) {
+			rte_pktmbuf_free(pkts[i]);
+			rte_port_drop(rte_port, DROP_TX_VXLAN, 1);
+			continue;
 		}
+
+		pkts[n++] = pkts[i];
 	}
+
+	trace(TRACE_VXLAN, peers->nr_peers, rte_port->stats_id, n);
+
+	for (i = 0; i < peers->nr_peers; i++) {
+		peer = &peers->peers[i];
+
+		if (i >= (peers->nr_peers - 1)) {
+			sent = udp_mbuf_send_burst(vxlan->sock, &peer->ip_addr,
+						   peer->port, pkts, n);
+			rte_port_drop(rte_port, DROP_TX_UDP, n - sent);
+			break;
+		}
+
+		for (j = 0; j < n; j++) {
+			clone = mempool_clone(pkts[j], indirect_pool);
+			if (!clone)
+				break;
+			pkts_clone[j] = clone;
+		}
+
+		if (j < n)
+			rte_port_drop(rte_port, DROP_TX_CLONE, n - j);
+
+		sent = udp_mbuf_send_burst(vxlan->sock, &peer->ip_addr,
+					   peer->port, pkts_clone, j);
+		rte_port_drop(rte_port, DROP_TX_UDP, j - sent);
+	}
+
+	CYCLES_END(CYCLES_VXLAN, tsc, n_pkts);
+
+	/* every mbuf has been consumed, nothing is left to the caller */
 	return n_pkts;
 }
@@ -33,9 +33,13 @@
 #ifndef _BRIDGE_H_
 #define _BRIDGE_H_
 
+#include <rte_byteorder.h>
+#include <rte_mbuf.h>
+
 #include <lwip/udp.h>
 
 #include "port-plug.h"
+#include "udp-mbuf.h"
 
 #define VXLAN_DST_PORT		4789
 
@@ -44,6 +48,9 @@ struct vxlanhdr {
 	u32_t	vx_vni;
 };
 
+#define VXLAN_FLAGS_I		0x08000000	/* valid VNI */
+#define VXLAN_VNI		0x100
+
 struct vxlan_peer {
 	ip_addr_t	 ip_addr;
 	u16_t		 port;
@@ -51,12 +58,42 @@ struct vxlan_peer {
 
 #define VXLAN_DST_MAX		8
 
-struct vxlan {
-	struct udp_pcb		*local;
-	struct udp_pcb		*peers[VXLAN_DST_MAX];
+/* replaced as a whole, see rcu.h */
+struct vxlan_peers {
 	int			 nr_peers;
+	struct vxlan_peer	 peers[VXLAN_DST_MAX];
+};
+
+struct vxlan {
+	struct udp_mbuf_sock	*sock;
+	struct vxlan_peers	*peers;
 };
 
+/* Pushes the VXLAN header, the UDP/IP/Ethernet ones are udp-mbuf's job */
+static inline int
+vxlan_encap(struct rte_mbuf *m)
+{
+	struct vxlanhdr *header;
+
+	header = (struct vxlanhdr *)rte_pktmbuf_prepend(m, sizeof(*header));
+	if (!header)
+		return -1;
+
+	header->vx_flags = rte_cpu_to_be_32(VXLAN_FLAGS_I);
+	header->vx_vni = rte_cpu_to_be_32(VXLAN_VNI);
+	return 0;
+}
+
+/* Strips every header up to the inner frame of a received datagram */
+static inline int
+vxlan_decap(struct rte_mbuf *m)
+{
+	if (rte_pktmbuf_adj(m, udp_mbuf_payload_offset(m) +
+			    sizeof(struct vxlanhdr)) == NULL)
+		return -1;
+	return 0;
+}
+
 #define BRIDGE_PORT_MAX		8
 
 struct bridge;
@@ -72,19 +109,28 @@ struct bridge_plug {
 	struct net_port	 net_port;
 };
 
+/* the ports in use, replaced as a whole, see rcu.h */
+struct bridge_table {
+	int			 nr_ports;
+	struct bridge_port	*ports[BRIDGE_PORT_MAX];
+};
+
 struct bridge {
-	struct bridge_port	ports[BRIDGE_PORT_MAX];
-	int			nr_ports;
-	struct bridge_plug	plug;
-	struct vxlan		vxlan;
+	struct bridge_port	 ports[BRIDGE_PORT_MAX];
+	struct bridge_table	*table;
+	struct bridge_plug	 plug;
+	struct vxlan		 vxlan;
 };
 
 extern struct bridge BR0;
 
 int bridge_add_port(struct bridge *bridge, struct net_port *net_port);
+int bridge_del_port(struct bridge *bridge, struct net_port *net_port);
 int bridge_add_plug(struct bridge *bridge, struct net_port *net_port,
 		    struct plugif *plugif);
 int bridge_add_vxlan(struct bridge *bridge, struct vxlan_peer *peer);
+int bridge_del_vxlan(struct bridge *bridge, struct vxlan_peer *peer);
+int bridge_nr_peers(struct bridge *bridge);
 int bridge_bind_vxlan(struct bridge *bridge);
 int bridge_input(struct bridge *bridge, struct bridge_port *ingress,
 		 struct rte_mbuf **pkts, int n_pkts);
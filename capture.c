@@ -0,0 +1,470 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include "capture.h"
+#include "main.h"
+#include "mempool.h"
+#include "rcu.h"
+#include "stats.h"
+
+/* the tap may be gone by the time its packets are written */
+struct capture_rec {
+	struct rte_mbuf		*m;		/* clone of the packet */
+	uint32_t		 snaplen;
+	uint16_t		 stats_id;
+	uint8_t			 dir;
+	uint64_t		 tsc;
+};
+
+volatile int capture_enabled;
+
+/* the taps of -C, those of the control socket are allocated */
+static struct capture_tap taps[CAPTURE_TAP_MAX];
+static int nr_taps;
+
+static char capture_path[PATH_MAX] = CAPTURE_PATH_DEFAULT;
+static int capture_running;
+
+static struct rte_ring *capture_ring;
+static struct rte_mempool *capture_rec_pool;
+
+/* the file of the writer, until it starts */
+int
+capture_set_path(const char *path)
+{
+	if (capture_running || strlen(path) >= sizeof(capture_path))
+		return -1;
+	strcpy(capture_path, path);
+	return 0;
+}
+
+static void
+capture_tap_defaults(struct capture_tap *tap)
+{
+	if (!tap->dirs)
+		tap->dirs = CAPTURE_RX | CAPTURE_TX;
+	if (!tap->snaplen || tap->snaplen > CAPTURE_SNAPLEN_MAX)
+		tap->snaplen = CAPTURE_SNAPLEN_MAX;
+}
+
+int
+capture_add_tap(struct capture_tap *tap)
+{
+	if (nr_taps >= CAPTURE_TAP_MAX)
+		return -1;
+
+	taps[nr_taps] = *tap;
+	capture_tap_defaults(&taps[nr_taps]);
+	nr_taps++;
+
+	return 0;
+}
+
+static int
+capture_match(struct capture_filter *filter, struct rte_mbuf *m)
+{
+	struct ether_hdr *eth = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	struct ipv4_hdr *ip;
+	struct udp_hdr *l4;
+	uint16_t hlen;
+
+	if (filter->ether_type && eth->ether_type != filter->ether_type)
+		return 0;
+
+	if (!filter->ip_proto && !filter->host.addr && !filter->port)
+		return 1;
+
+	/* only the first segment is looked at */
+	hlen = sizeof(*eth) + sizeof(*ip);
+	if (eth->ether_type != rte_cpu_to_be_16(ETHER_TYPE_IPv4) ||
+	    rte_pktmbuf_data_len(m) < hlen)
+		return 0;
+
+	ip = (struct ipv4_hdr *)(eth + 1);
+	if (filter->ip_proto && ip->next_proto_id != filter->ip_proto)
+		return 0;
+	if (filter->host.addr && ip->src_addr != filter->host.addr &&
+	    ip->dst_addr != filter->host.addr)
+		return 0;
+	if (!filter->port)
+		return 1;
+
+	if (ip->next_proto_id != IPPROTO_UDP &&
+	    ip->next_proto_id != IPPROTO_TCP)
+		return 0;
+
+	/* the ports lead both UDP and TCP headers */
+	hlen = sizeof(*eth) +
+		(ip->version_ihl & IPV4_HDR_IHL_MASK) * IPV4_IHL_MULTIPLIER;
+	if (rte_pktmbuf_data_len(m) < hlen + 4)
+		return 0;
+
+	l4 = (struct udp_hdr *)((char *)eth + hlen);
+	return l4->src_port == filter->port || l4->dst_port == filter->port;
+}
+
+void
+capture_burst_slow(struct rte_port *rte_port, struct capture_tap *tap,
+		   uint8_t dir, struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct capture_rec *recs[n_pkts];
+	uint64_t tsc = rte_rdtsc();
+	uint32_t i, n = 0, sent;
+
+	if (rte_mempool_get_bulk(capture_rec_pool, (void **)recs,
+				 n_pkts) != 0)
+		return;
+
+	for (i = 0; i < n_pkts; i++) {
+		if (!capture_match(&tap->filter, pkts[i]))
+			continue;
+
+		/* shares the data, the header fields stay our own */
+		recs[n]->m = mempool_clone(pkts[i], indirect_pool);
+		if (recs[n]->m == NULL)
+			break;
+		recs[n]->snaplen = tap->snaplen;
+		recs[n]->stats_id = rte_port->stats_id;
+		recs[n]->dir = dir;
+		recs[n]->tsc = tsc;
+		n++;
+	}
+
+	sent = rte_ring_mp_enqueue_burst(capture_ring, (void **)recs, n);
+	for (i = sent; i < n; i++)
+		rte_pktmbuf_free(recs[i]->m);
+	rte_mempool_put_bulk(capture_rec_pool, (void **)&recs[sent],
+			     n_pkts - sent);
+}
+
+static void
+capture_signal(int sig)
+{
+	capture_enabled = !capture_enabled;
+}
+
+struct pcapng_writer {
+	FILE		*f;
+	uint64_t	 hz;
+	uint64_t	 base_tsc;
+	uint64_t	 base_us;
+	uint32_t	 nr_idbs;	/* interfaces described so far */
+};
+
+static void
+pcapng_block(FILE *f, uint32_t type, const void *body, uint32_t len)
+{
+	uint32_t total = 12 + len;
+
+	fwrite(&type, 4, 1, f);
+	fwrite(&total, 4, 1, f);
+	fwrite(body, len, 1, f);
+	fwrite(&total, 4, 1, f);
+}
+
+/* one interface per port, identified by its stats id; ports added
+ * from the control socket get theirs before their first packet
+ */
+static void
+pcapng_idbs(struct pcapng_writer *w, uint32_t nr_ids)
+{
+	struct {
+		uint16_t linktype, reserved;
+		uint32_t snaplen;
+	} __attribute__((packed)) idb = {
+		PCAPNG_LINKTYPE_ETHER, 0, CAPTURE_SNAPLEN_MAX
+	};
+
+	for (; w->nr_idbs < nr_ids; w->nr_idbs++)
+		pcapng_block(w->f, PCAPNG_IDB, &idb, sizeof(idb));
+}
+
+static void
+pcapng_header(struct pcapng_writer *w)
+{
+	struct {
+		uint32_t magic;
+		uint16_t major, minor;
+		int64_t	 section_len;
+	} __attribute__((packed)) shb = { PCAPNG_MAGIC, 1, 0, -1 };
+
+	pcapng_block(w->f, PCAPNG_SHB, &shb, sizeof(shb));
+	pcapng_idbs(w, stats_shm->nr_ports);
+}
+
+static void
+pcapng_packet(struct pcapng_writer *w, struct capture_rec *rec)
+{
+	static const uint8_t pad[4];
+	struct rte_mbuf *m = rec->m, *seg;
+	uint64_t us = w->base_us +
+		(rec->tsc - w->base_tsc) * 1000000 / w->hz;
+	uint32_t caplen = RTE_MIN(rte_pktmbuf_pkt_len(m), rec->snaplen);
+	uint32_t padlen = (4 - (caplen & 3)) & 3;
+	uint32_t len, left;
+	struct {
+		uint32_t interface_id;
+		uint32_t ts_high, ts_low;
+		uint32_t caplen, len;
+	} epb = {
+		rec->stats_id,
+		(uint32_t)(us >> 32), (uint32_t)us,
+		caplen, rte_pktmbuf_pkt_len(m),
+	};
+	struct {
+		uint16_t code, len;
+		uint32_t flags;
+		uint32_t end;
+	} opts = {
+		PCAPNG_OPT_EPB_FLAGS, 4,
+		rec->dir == CAPTURE_RX ? PCAPNG_EPB_INBOUND :
+			PCAPNG_EPB_OUTBOUND,
+		PCAPNG_OPT_END,
+	};
+	uint32_t type = PCAPNG_EPB;
+	uint32_t total = 12 + sizeof(epb) + caplen + padlen + sizeof(opts);
+
+	pcapng_idbs(w, epb.interface_id + 1);
+
+	fwrite(&type, 4, 1, w->f);
+	fwrite(&total, 4, 1, w->f);
+	fwrite(&epb, sizeof(epb), 1, w->f);
+	for (seg = m, left = caplen; seg && left; seg = seg->pkt.next) {
+		len = RTE_MIN(left, rte_pktmbuf_data_len(seg));
+		fwrite(rte_pktmbuf_mtod(seg, void *), len, 1, w->f);
+		left -= len;
+	}
+	fwrite(pad, padlen, 1, w->f);
+	fwrite(&opts, sizeof(opts), 1, w->f);
+	fwrite(&total, 4, 1, w->f);
+}
+
+/* Runs on its own lcore, the only one doing file I/O */
+static int
+capture_writer(void *arg)
+{
+	struct pcapng_writer *w = (struct pcapng_writer *)arg;
+	struct capture_rec *recs[PKT_BURST_SZ];
+	unsigned i, n;
+
+	for (;;) {
+		n = rte_ring_sc_dequeue_burst(capture_ring, (void **)recs,
+					      PKT_BURST_SZ);
+		if (n == 0) {
+			fflush(w->f);
+			usleep(1000);
+			continue;
+		}
+
+		for (i = 0; i < n; i++) {
+			pcapng_packet(w, recs[i]);
+			rte_pktmbuf_free(recs[i]->m);
+		}
+		rte_mempool_put_bulk(capture_rec_pool, (void **)recs, n);
+	}
+	return 0;
+}
+
+/* opens the file and launches the writer on the first spare lcore, once;
+ * run on the master lcore
+ */
+static int
+capture_writer_start(void)
+{
+	static struct pcapng_writer writer;
+	struct timeval tv;
+	unsigned lcore_id;
+
+	if (capture_running)
+		return 0;
+
+	lcore_id = spare_lcore();
+	if (lcore_id >= RTE_MAX_LCORE) {
+		RTE_LOG(ERR, APP, "No spare lcore for the capture writer\n");
+		return -1;
+	}
+
+	if (capture_ring == NULL)
+		capture_ring = rte_ring_create("capture_ring",
+					       CAPTURE_RING_SIZE,
+					       rte_socket_id(), RING_F_SC_DEQ);
+	if (capture_ring == NULL) {
+		RTE_LOG(ERR, APP, "Cannot create capture ring\n");
+		return -1;
+	}
+
+	if (capture_rec_pool == NULL)
+		capture_rec_pool = rte_mempool_create(
+			"capture_rec_pool", CAPTURE_RING_SIZE + PKT_BURST_SZ,
+			sizeof(struct capture_rec), MEMPOOL_CACHE_SZ, 0,
+			NULL, NULL, NULL, NULL, rte_socket_id(), 0);
+	if (capture_rec_pool == NULL) {
+		RTE_LOG(ERR, APP, "Cannot create capture pool\n");
+		return -1;
+	}
+
+	writer.f = fopen(capture_path, "w");
+	if (writer.f == NULL) {
+		RTE_LOG(ERR, APP, "Cannot open %s\n", capture_path);
+		return -1;
+	}
+
+	gettimeofday(&tv, NULL);
+	writer.hz = rte_get_tsc_hz();
+	writer.base_tsc = rte_rdtsc();
+	writer.base_us = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+	pcapng_header(&writer);
+
+	if (rte_eal_remote_launch(capture_writer, &writer, lcore_id) != 0) {
+		RTE_LOG(ERR, APP, "Cannot launch the capture writer\n");
+		fclose(writer.f);
+		return -1;
+	}
+
+	signal(SIGUSR2, capture_signal);
+	capture_enabled = 1;
+	capture_running = 1;
+
+	RTE_LOG(INFO, APP, "Capturing into %s on lcore %u\n",
+		capture_path, lcore_id);
+
+	return 0;
+}
+
+/*
+ * Attaches the taps of -C to their ports and starts the writer, if there
+ * are any. SIGUSR2 toggles the capture on and off afterwards.
+ */
+int
+capture_start(void)
+{
+	int i;
+
+	if (nr_taps == 0)
+		return 0;
+
+	for (i = 0; i < nr_taps; i++) {
+		taps[i].rte_port = stats_port_lookup(taps[i].name);
+		if (taps[i].rte_port == NULL) {
+			RTE_LOG(ERR, APP, "No port %s to capture\n",
+				taps[i].name);
+			return -1;
+		}
+	}
+
+	if (capture_writer_start() != 0)
+		return -1;
+
+	/* the taps go live last */
+	rte_wmb();
+	for (i = 0; i < nr_taps; i++)
+		taps[i].rte_port->capture = &taps[i];
+
+	return 0;
+}
+
+/*
+ * Run on the dispatch lcore, from the control socket
+ */
+
+/* taps a port, starting the writer for the first tap */
+int
+capture_port_add(struct capture_tap *tap)
+{
+	struct rte_port *rte_port;
+	struct capture_tap *copy;
+
+	rte_port = stats_port_lookup(tap->name);
+	if (rte_port == NULL) {
+		RTE_LOG(ERR, APP, "No port %s to capture\n", tap->name);
+		return -1;
+	}
+	if (rte_port->capture != NULL) {
+		RTE_LOG(ERR, APP, "Port %s is already tapped\n", tap->name);
+		return -1;
+	}
+
+	if (capture_writer_start() != 0)
+		return -1;
+
+	copy = rte_malloc("capture_tap", sizeof(*copy), 0);
+	if (copy == NULL)
+		return -1;
+	*copy = *tap;
+	capture_tap_defaults(copy);
+	copy->name = NULL;		/* points into the command */
+	copy->rte_port = rte_port;
+
+	rcu_assign(rte_port->capture, copy);
+	return 0;
+}
+
+/* the packets already queued are still written */
+int
+capture_port_del(const char *name)
+{
+	struct rte_port *rte_port;
+	struct capture_tap *tap;
+
+	rte_port = stats_port_lookup(name);
+	if (rte_port == NULL || rte_port->capture == NULL)
+		return -1;
+
+	tap = rte_port->capture;
+	rte_port->capture = NULL;
+	if (tap < taps || tap >= taps + CAPTURE_TAP_MAX)
+		rcu_free(tap);
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+
+#include <lwip/ip_addr.h>
+
+#include "port.h"
+#include "rcu.h"
+
+#define CAPTURE_TAP_MAX		8
+
+/* Mirrored packets waiting for the writer lcore */
+#define CAPTURE_RING_SIZE	4096
+
+#define CAPTURE_SNAPLEN_MAX	65535
+#define CAPTURE_PATH_DEFAULT	"lwip-dpdk.pcapng"
+
+/* pcapng block types and options, also read back by replay.c */
+#define PCAPNG_SHB		0x0A0D0D0A
+#define PCAPNG_IDB		0x00000001
+#define PCAPNG_EPB		0x00000006
+#define PCAPNG_MAGIC		0x1A2B3C4D
+#define PCAPNG_LINKTYPE_ETHER	1
+#define PCAPNG_OPT_END		0
+#define PCAPNG_OPT_EPB_FLAGS	2
+#define PCAPNG_EPB_INBOUND	1
+#define PCAPNG_EPB_OUTBOUND	2
+
+/* Directions of a tap */
+#define CAPTURE_RX		0x1
+#define CAPTURE_TX		0x2
+
+/* Any field left 0 matches everything */
+struct capture_filter {
+	uint16_t	 ether_type;
+	uint8_t		 ip_proto;
+	ip_addr_t	 host;
+	uint16_t	 port;		/* UDP or TCP, either way */
+};
+
+struct capture_tap {
+	char			*name;		/* of the port */
+	uint8_t			 dirs;
+	uint32_t		 snaplen;
+	struct capture_filter	 filter;
+	struct rte_port		*rte_port;
+};
+
+extern volatile int capture_enabled;
+
+int capture_add_tap(struct capture_tap *tap);
+int capture_set_path(const char *path);
+int capture_start(void);
+int capture_port_add(struct capture_tap *tap);
+int capture_port_del(const char *name);
+void capture_burst_slow(struct rte_port *rte_port, struct capture_tap *tap,
+			uint8_t dir, struct rte_mbuf **pkts, uint32_t n_pkts);
+
+/* buffer ownership and responsivity [capture]
+ *   mbuf: the caller keeps the ownership of all mbuf, the tap only
+ *         holds clones of them
+ */
+static inline void
+capture_burst(struct rte_port *rte_port, uint8_t dir,
+	      struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct capture_tap *tap = rcu_dereference(rte_port->capture);
+
+	if (unlikely(tap != NULL) && (tap->dirs & dir) && capture_enabled)
+		capture_burst_slow(rte_port, tap, dir, pkts, n_pkts);
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rte_memcpy.h>
+
+#include "convert.h"
+#include "latency.h"
+
+/* buffer ownership and responsivity [mbuf_to_pbuf]
+ *   pbuf: transfer the ownership of a newly allocated pbuf to the caller
+ *   mbuf: return all to the caller
+ */
+struct pbuf *
+mbuf_to_pbuf(struct rte_mbuf *m)
+{
+	struct pbuf *p, *q;
+	char *dat = rte_pktmbuf_mtod(m, char *);
+	uint32_t len = rte_pktmbuf_data_len(m);
+	uint32_t off, n;
+
+	p = pbuf_alloc(PBUF_RAW, rte_pktmbuf_pkt_len(m), PBUF_POOL);
+	if (p == 0)
+		return NULL;
+
+	for(q = p; q != NULL; q = q->next) {
+		for (off = 0; off < q->len; off += n) {
+			while (len == 0) {
+				m = m->pkt.next;
+				if (unlikely(m == NULL)) {
+					pbuf_free(p);
+					return NULL;
+				}
+				dat = rte_pktmbuf_mtod(m, char *);
+				len = rte_pktmbuf_data_len(m);
+			}
+			n = RTE_MIN(len, (uint32_t)q->len - off);
+			rte_memcpy((char *)q->payload + off, dat, n);
+			dat += n;
+			len -= n;
+		}
+	}
+	return p;
+}
+
+/* buffer ownership and responsivity [pbuf_to_mbuf]
+ *   pbuf: return all to the caller
+ *   mbuf: transfer the ownership of a newly allocated mbuf to the caller
+ *
+ * A pbuf chain larger than the tailroom of one mbuf, e.g. a jumbo frame,
+ * is spread over a chain of mbufs. Only the first one keeps headroom.
+ */
+struct rte_mbuf *
+pbuf_to_mbuf(struct pbuf *p, struct rte_mempool *mp)
+{
+	struct rte_mbuf *m, *seg;
+	struct pbuf *q;
+	char *dat;
+	uint32_t len, n;
+
+	m = rte_pktmbuf_alloc(mp);
+	if (m == NULL)
+		return NULL;
+
+	/* not received, see latency.h */
+	mbuf_tsc_set(m, 0);
+
+	seg = m;
+	for(q = p; q != NULL; q = q->next) {
+		dat = (char *)q->payload;
+		len = q->len;
+		while (len > 0) {
+			n = RTE_MIN(len, (uint32_t)rte_pktmbuf_tailroom(seg));
+			if (unlikely(n == 0)) {
+				seg->pkt.next = rte_pktmbuf_alloc(mp);
+				if (seg->pkt.next == NULL) {
+					rte_pktmbuf_free(m);
+					return NULL;
+				}
+				seg = seg->pkt.next;
+				seg->pkt.data = seg->buf_addr;
+				m->pkt.nb_segs++;
+				continue;
+			}
+			rte_memcpy(rte_pktmbuf_mtod(seg, char *) +
+				   seg->pkt.data_len, dat, n);
+			seg->pkt.data_len += n;
+			m->pkt.pkt_len += n;
+			dat += n;
+			len -= n;
+		}
+	}
+	return m;
+}
@@ -0,0 +1,564 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_malloc.h>
+
+#include <lwip/netif.h>
+#include <netif/etharp.h>
+
+#include "bridge.h"
+#include "capture.h"
+#include "ctl.h"
+#include "dispatch.h"
+#include "ethif.h"
+#include "kniif.h"
+#include "ringif.h"
+#include "tapif.h"
+#ifdef ENABLE_VHOST
+#include "port-vhost.h"
+#endif
+#include "main.h"
+#include "rcu.h"
+#include "route.h"
+
+struct rte_ring *ctl_ring;
+
+static int ctl_fd = -1;
+
+struct ctl_cmd;
+typedef int (*ctl_fn)(struct ctl_cmd *cmd);
+
+struct ctl_cmd {
+	ctl_fn			 fn;
+	rte_port_type		 type;
+	struct net		 net;
+	char			*name;
+	struct vxlan_peer	 peer;
+	struct capture_tap	 tap;
+	ip_addr_t		 ip_addr;
+	ip_addr_t		 netmask;
+	struct eth_addr		 mac;
+	int			 has_mac;
+	struct net_port		*added;		/* set up before the command */
+	struct net_port		*retired;	/* released after RCU */
+	int			 ret;
+	volatile int		 done;
+};
+
+/*
+ * Run on the dispatch lcore
+ */
+
+static int
+ctl_port_add(struct ctl_cmd *cmd)
+{
+	return port_attach(cmd->added);
+}
+
+static int
+ctl_port_del(struct ctl_cmd *cmd)
+{
+	struct net_port *net_port;
+
+	net_port = port_lookup(cmd->name);
+	if (net_port == NULL ||
+	    net_port->rte_port_type == RTE_PORT_TYPE_PLUG)
+		return -1;
+
+	dispatch_del_port(net_port);
+	if (net_port->rte_port_type == RTE_PORT_TYPE_KNI)
+		rte_port_kni_stop(container_of(net_port->rte_port,
+					       struct rte_port_kni, rte_port));
+	if (net_port->bridge_port)
+		bridge_del_port(net_port->bridge_port->bridge, net_port);
+	if (net_port->netif) {
+		route_del_netif(net_port->netif);
+		netif_remove(net_port->netif);
+	}
+
+	cmd->retired = net_port;
+	return 0;
+}
+
+static int
+ctl_peer_add(struct ctl_cmd *cmd)
+{
+	if (bridge_add_vxlan(&BR0, &cmd->peer) != 0)
+		return -1;
+
+	/* the first peer of a running plug port */
+	if (BR0.plug.net_port.rte_port && !BR0.vxlan.sock)
+		return bridge_bind_vxlan(&BR0) == ERR_OK ? 0 : -1;
+	return 0;
+}
+
+static int
+ctl_peer_del(struct ctl_cmd *cmd)
+{
+	return bridge_del_vxlan(&BR0, &cmd->peer);
+}
+
+static int
+ctl_arp_add(struct ctl_cmd *cmd)
+{
+	if (!cmd->has_mac)
+		return -1;
+	return etharp_add_static_entry(&cmd->ip_addr, &cmd->mac) == ERR_OK ?
+		0 : -1;
+}
+
+static int
+ctl_arp_del(struct ctl_cmd *cmd)
+{
+	return etharp_remove_static_entry(&cmd->ip_addr) == ERR_OK ? 0 : -1;
+}
+
+static int
+ctl_route_add(struct ctl_cmd *cmd)
+{
+	struct net_port *net_port;
+
+	if (cmd->name == NULL)
+		return -1;
+
+	net_port = port_lookup(cmd->name);
+	if (net_port == NULL || net_port->netif == NULL) {
+		RTE_LOG(ERR, APP, "No lwIP port %s to route to\n", cmd->name);
+		return -1;
+	}
+	return route_add(&cmd->ip_addr, &cmd->netmask, net_port->netif);
+}
+
+static int
+ctl_route_del(struct ctl_cmd *cmd)
+{
+	return route_del(&cmd->ip_addr, &cmd->netmask);
+}
+
+static int
+ctl_capture_add(struct ctl_cmd *cmd)
+{
+	return capture_port_add(&cmd->tap);
+}
+
+static int
+ctl_capture_del(struct ctl_cmd *cmd)
+{
+	return capture_port_del(cmd->tap.name);
+}
+
+void
+ctl_run(void)
+{
+	struct ctl_cmd *cmd;
+
+	while (rte_ring_sc_dequeue(ctl_ring, (void **)&cmd) == 0) {
+		cmd->ret = cmd->fn(cmd);
+		rte_wmb();
+		cmd->done = 1;
+	}
+}
+
+/*
+ * Run on the control lcore
+ */
+
+/* stops what is left of a port once no round can reach it, or of one that
+ * failed to attach; the rte_port stays as the statistics and the taps keep
+ * pointing to it
+ */
+static void
+ctl_port_release(struct net_port *net_port)
+{
+	struct rte_port_kni *kni_port;
+
+	switch (net_port->rte_port_type) {
+	case RTE_PORT_TYPE_ETH:
+		rte_eth_dev_stop(net_port->net.port_id);
+		if (net_port->netif)
+			rte_free(net_port->netif->state);
+		break;
+	case RTE_PORT_TYPE_KNI:
+		kni_port = container_of(net_port->rte_port,
+					struct rte_port_kni, rte_port);
+		rte_kni_release(kni_port->kni);
+		if (net_port->netif)
+			rte_free(net_port->netif->state);
+		break;
+	case RTE_PORT_TYPE_RING:
+		/* the rings stay for the other process */
+		if (net_port->netif)
+			rte_free(net_port->netif->state);
+		break;
+	case RTE_PORT_TYPE_TAP:
+		rte_port_tap_release(container_of(net_port->rte_port,
+						  struct rte_port_tap,
+						  rte_port));
+		if (net_port->netif)
+			rte_free(net_port->netif->state);
+		break;
+#ifdef ENABLE_VHOST
+	case RTE_PORT_TYPE_VHOST:
+		rte_port_vhost_release(container_of(net_port->rte_port,
+						    struct rte_port_vhost,
+						    rte_port));
+		break;
+#endif
+	default:
+		break;
+	}
+
+	/* the entry is free for the next port */
+	rte_wmb();
+	net_port->rte_port_type = 0;
+}
+
+/* the device and the pools of a new port, as their setup takes system
+ * calls and memzone reservations a dispatch round should not wait for
+ */
+static int
+ctl_port_setup(struct ctl_cmd *cmd)
+{
+	struct net_port *net_port;
+	char name[RTE_KNI_NAMESIZE];
+
+	/* a bond is named after its port_id, checked once bonded */
+	if (cmd->type == RTE_PORT_TYPE_ETH && cmd->net.nr_members > 0)
+		name[0] = 0;
+	else if (cmd->type == RTE_PORT_TYPE_ETH)
+		snprintf(name, sizeof(name), "eth%u", cmd->net.port_id);
+	else
+		snprintf(name, sizeof(name), "%s", cmd->net.name);
+	if (name[0] && port_lookup(name) != NULL) {
+		RTE_LOG(ERR, APP, "Port %s already exists\n", name);
+		return -1;
+	}
+
+	net_port = port_alloc();
+	if (net_port == NULL) {
+		RTE_LOG(ERR, APP, "Too many ports\n");
+		return -1;
+	}
+
+	net_port->net = cmd->net;
+	net_port->rte_port_type = cmd->type;
+	if (port_setup(net_port) != 0) {
+		net_port->rte_port_type = 0;
+		return -1;
+	}
+	cmd->added = net_port;
+	return 0;
+}
+
+static int
+ctl_addr_pair(void *opts, char *key, char *value)
+{
+	struct ctl_cmd *cmd = (struct ctl_cmd *)opts;
+	struct eth_addr *mac = &cmd->mac;
+
+	if (key == 0 || *key == 0 || value == 0 || *value == 0)
+		return -1;
+
+	if (!strcmp(key, "addr") || !strcmp(key, "dst")) {
+		return ipaddr_aton(value, &cmd->ip_addr) ? 0 : -1;
+	} else if (!strcmp(key, "netmask")) {
+		return ipaddr_aton(value, &cmd->netmask) ? 0 : -1;
+	} else if (!strcmp(key, "mac")) {
+		cmd->has_mac = 1;
+		return sscanf(value, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+			      &mac->addr[0], &mac->addr[1], &mac->addr[2],
+			      &mac->addr[3], &mac->addr[4],
+			      &mac->addr[5]) == 6 ? 0 : -1;
+	} else if (!strcmp(key, "port")) {
+		cmd->name = value;
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
+/*
+ * <object> <add|del> [args], with the args of a port and a peer as in
+ * -e/-k and -V:
+ *
+ *   port add eth port_id=1,addr=10.0.1.1,netmask=255.255.255.0
+ *   port add eth members=2:3,xmit_policy=l34
+ *   port add kni name=vEth1
+ *   port add ring name=app0
+ *   port add tap name=tap1
+ *   port add vhost name=vm0
+ *   port del eth1
+ *   peer add|del addr=192.168.0.2[,port=4789]
+ *   arp add addr=10.0.1.2,mac=02:00:00:00:00:02
+ *   arp del addr=10.0.1.2
+ *   route add dst=10.2.0.0,netmask=255.255.0.0,port=eth1
+ *   route del dst=10.2.0.0,netmask=255.255.0.0
+ *   capture add port=eth1,dir=rx,proto=udp[,file=eth1.pcapng]
+ *   capture del port=eth1
+ *
+ * The line is kept as a port name may point into it.
+ */
+static int
+ctl_parse(struct ctl_cmd *cmd, char *line)
+{
+	char *obj, *verb, *arg, *save;
+	int add;
+
+	obj = strtok_r(line, " \t\r\n", &save);
+	verb = strtok_r(NULL, " \t\r\n", &save);
+	if (obj == NULL || verb == NULL)
+		return -1;
+
+	if (!strcmp(verb, "add"))
+		add = 1;
+	else if (!strcmp(verb, "del"))
+		add = 0;
+	else
+		return -1;
+
+	if (!strcmp(obj, "port") && add) {
+		arg = strtok_r(NULL, " \t\r\n", &save);
+		if (arg == NULL)
+			return -1;
+		if (!strcmp(arg, "eth"))
+			cmd->type = RTE_PORT_TYPE_ETH;
+		else if (!strcmp(arg, "kni"))
+			cmd->type = RTE_PORT_TYPE_KNI;
+		else if (!strcmp(arg, "ring"))
+			cmd->type = RTE_PORT_TYPE_RING;
+		else if (!strcmp(arg, "tap"))
+			cmd->type = RTE_PORT_TYPE_TAP;
+#ifdef ENABLE_VHOST
+		else if (!strcmp(arg, "vhost"))
+			cmd->type = RTE_PORT_TYPE_VHOST;
+#endif
+		else
+			return -1;
+		arg = strtok_r(NULL, " \t\r\n", &save);
+		if (arg == NULL || parse_port(&cmd->net, arg) != 0)
+			return -1;
+		if (cmd->type != RTE_PORT_TYPE_ETH && cmd->net.name == NULL)
+			return -1;
+		cmd->fn = ctl_port_add;
+		return 0;
+	}
+
+	arg = strtok_r(NULL, " \t\r\n", &save);
+	if (arg == NULL)
+		return -1;
+
+	if (!strcmp(obj, "port")) {
+		cmd->name = arg;
+		cmd->fn = ctl_port_del;
+	} else if (!strcmp(obj, "peer")) {
+		if (parse_vxlan(&cmd->peer, arg) != 0)
+			return -1;
+		cmd->fn = add ? ctl_peer_add : ctl_peer_del;
+	} else if (!strcmp(obj, "arp")) {
+		if (parse_pairs(cmd, arg, ctl_addr_pair) != 0)
+			return -1;
+		cmd->fn = add ? ctl_arp_add : ctl_arp_del;
+	} else if (!strcmp(obj, "route")) {
+		if (parse_pairs(cmd, arg, ctl_addr_pair) != 0)
+			return -1;
+		cmd->fn = add ? ctl_route_add : ctl_route_del;
+	} else if (!strcmp(obj, "capture")) {
+		if (parse_capture(&cmd->tap, arg) != 0)
+			return -1;
+		cmd->fn = add ? ctl_capture_add : ctl_capture_del;
+	} else {
+		return -1;
+	}
+	return 0;
+}
+
+static int
+ctl_exec(const char *buf)
+{
+	struct ctl_cmd *cmd;
+	char *line;
+	int ret;
+
+	line = strdup(buf);
+	if (line == NULL)
+		return -1;
+
+	/* not on the stack, the dispatch lcore may dequeue it after a quit */
+	cmd = calloc(1, sizeof(*cmd));
+	if (cmd == NULL) {
+		free(line);
+		return -1;
+	}
+
+	if (ctl_parse(cmd, line) != 0 ||
+	    (cmd->fn == ctl_port_add && ctl_port_setup(cmd) != 0)) {
+		free(cmd);
+		free(line);
+		return -1;
+	}
+
+	if (rte_ring_sp_enqueue(ctl_ring, cmd) != 0) {
+		if (cmd->added)
+			ctl_port_release(cmd->added);
+		free(cmd);
+		free(line);
+		return -1;
+	}
+	dispatch_wakeup();
+
+	/* the command and its line are left to the exit */
+	while (!cmd->done) {
+		if (dispatch_quit)
+			return -1;
+		rte_delay_us(100);
+	}
+	rte_rmb();
+
+	/* the tables replaced by the command, then the port it removed */
+	rcu_reclaim();
+	if (cmd->retired)
+		ctl_port_release(cmd->retired);
+	if (cmd->added && cmd->ret != 0)
+		ctl_port_release(cmd->added);
+
+	if (cmd->fn != ctl_port_add || cmd->ret != 0)
+		free(line);
+	ret = cmd->ret;
+	free(cmd);
+	return ret;
+}
+
+static int
+ctl_server(void *arg)
+{
+	char line[CTL_LINE_MAX];
+	FILE *f;
+	int conn;
+
+	for (;;) {
+		conn = accept(ctl_fd, NULL, NULL);
+		if (conn < 0) {
+			if (errno == EINTR)
+				continue;
+			RTE_LOG(ERR, APP, "Cannot accept on control socket\n");
+			return -1;
+		}
+
+		f = fdopen(conn, "r");
+		if (f == NULL) {
+			close(conn);
+			continue;
+		}
+
+		/* one reply per command line */
+		while (fgets(line, sizeof(line), f)) {
+			if (*line == '#' || *line == '\n')
+				continue;
+			if (ctl_exec(line) == 0)
+				dprintf(conn, "ok\n");
+			else
+				dprintf(conn, "error\n");
+		}
+		fclose(f);
+	}
+	return 0;
+}
+
+/*
+ * Listens on the Unix socket at path and launches the server on the
+ * first spare lcore.
+ */
+int
+ctl_start(const char *path)
+{
+	struct sockaddr_un addr;
+	unsigned lcore_id;
+
+	lcore_id = spare_lcore();
+	if (lcore_id >= RTE_MAX_LCORE) {
+		RTE_LOG(ERR, APP, "No spare lcore for the control socket\n");
+		return -1;
+	}
+
+	ctl_ring = rte_ring_create("ctl_ring", CTL_RING_SIZE, rte_socket_id(),
+				   RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (ctl_ring == NULL) {
+		RTE_LOG(ERR, APP, "Cannot create control ring\n");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		RTE_LOG(ERR, APP, "Control socket path too long\n");
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	ctl_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ctl_fd < 0) {
+		RTE_LOG(ERR, APP, "Cannot create control socket\n");
+		return -1;
+	}
+
+	unlink(path);
+	if (bind(ctl_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(ctl_fd, 1) < 0) {
+		RTE_LOG(ERR, APP, "Cannot listen on %s\n", path);
+		close(ctl_fd);
+		return -1;
+	}
+
+	if (rte_eal_remote_launch(ctl_server, NULL, lcore_id) != 0) {
+		RTE_LOG(ERR, APP, "Cannot launch the control socket\n");
+		close(ctl_fd);
+		return -1;
+	}
+
+	RTE_LOG(INFO, APP, "Control socket %s on lcore %u\n", path, lcore_id);
+
+	return 0;
+}
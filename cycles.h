@@ -0,0 +1,68 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _CYCLES_H_
+#define _CYCLES_H_
+
+#include <stdint.h>
+
+#include <rte_cycles.h>
+
+/* Stages of the pipeline, nested stages are included in their parent */
+typedef enum {
+	CYCLES_RX = 0,		/* rx_burst of a port */
+	CYCLES_CONVERT,		/* mbuf to pbuf and back */
+	CYCLES_LWIP,		/* netif input into lwIP */
+	CYCLES_BRIDGE,		/* bridge_input flooding */
+	CYCLES_VXLAN,		/* VXLAN encapsulation and send */
+	CYCLES_TX,		/* tx_burst of a port */
+	CYCLES_STAGE_MAX,
+} cycles_stage;
+
+struct cycles_stats {
+	uint64_t	cycles;
+	uint64_t	calls;
+	uint64_t	pkts;
+};
+
+extern const char *cycles_stage_names[CYCLES_STAGE_MAX];
+
+/* Compiled in with --enable-cycles only, two rte_rdtsc() per stage */
+#ifdef ENABLE_CYCLES
+#define CYCLES_BEGIN(tsc)		uint64_t tsc = rte_rdtsc()
+#define CYCLES_END(stage, tsc, n_pkts)	cycles_add(stage, tsc, n_pkts)
+#else
+#define CYCLES_BEGIN(tsc)		do { } while (0)
+#define CYCLES_END(stage, tsc, n_pkts)	do { } while (0)
+#endif
+
+#endif
@@ -30,19 +30,45 @@
  *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define _GNU_SOURCE
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <rte_cycles.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 
 #include <lwip/timers.h>
 
 #include "bridge.h"
+#include "ctl.h"
 #include "dispatch.h"
 #include "ethif.h"
+#include "ipfrag.h"
 #include "kniif.h"
 #include "main.h"
+#include "mempool.h"
+#include "rcu.h"
+#include "ringif.h"
+#include "tapif.h"
+#include "udp-mbuf.h"
+#include "stats.h"
+#include "wheel.h"
+
+static uint64_t tsc_per_us;
+static int wakeup_fd = -1;
+
+volatile int dispatch_quit;
+
+/* the ports polled by the dispatch loop, see rcu.h */
+static struct dispatch_table *dispatch_table;
 
 static int
 dispatch_to_ethif(struct netif *netif,
@@ -74,6 +100,36 @@ dispatch_to_kniif(struct netif *netif,
 	return n_pkts;
 }
 
+static int
+dispatch_to_ringif(struct netif *netif,
+		   struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct ringif *ringif = (struct ringif *)netif->state;
+	uint32_t i;
+
+	RTE_VERIFY(ringif->rte_port_type == RTE_PORT_TYPE_RING);
+
+	for (i = 0; i < n_pkts; i++)
+		ringif_input(ringif, pkts[i]);
+
+	return n_pkts;
+}
+
+static int
+dispatch_to_tapif(struct netif *netif,
+		  struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct tapif *tapif = (struct tapif *)netif->state;
+	uint32_t i;
+
+	RTE_VERIFY(tapif->rte_port_type == RTE_PORT_TYPE_TAP);
+
+	for (i = 0; i < n_pkts; i++)
+		tapif_input(tapif, pkts[i]);
+
+	return n_pkts;
+}
+
 static int
 dispatch_to_bridge(struct net_port *source_port,
 		   struct rte_mbuf **pkts, uint32_t n_pkts)
@@ -84,61 +140,380 @@ dispatch_to_bridge(struct net_port *source_port,
 	return bridge_input(bridge, bridge_port, pkts, n_pkts);
 }
 
+/*
+ * Adaptive ports that keep returning nothing are polled less and less
+ * often, up to idle_us apart, and back to every iteration on the first
+ * packet. Returns the TSC until which the port needs no polling.
+ */
+static inline uint64_t
+dispatch_poll_update(struct net_port *net_port, uint32_t n_pkts, uint64_t now)
+{
+	struct net_poll *poll = &net_port->poll;
+	uint32_t idle_us;
+
+	if (likely(n_pkts > 0 || net_port->net.poll_mode == NET_POLL_BUSY)) {
+		poll->empty_polls = 0;
+		poll->backoff_us = 0;
+		poll->next_tsc = 0;
+		return now;
+	}
+
+	if (++poll->empty_polls < POLL_IDLE_THRESHOLD)
+		return now;
+
+	idle_us = net_port->net.idle_us ? : POLL_IDLE_US_DEFAULT;
+	poll->backoff_us = RTE_MIN(poll->backoff_us ? poll->backoff_us * 2 : 1,
+				   idle_us);
+	poll->next_tsc = now + poll->backoff_us * tsc_per_us;
+
+	return poll->next_tsc;
+}
+
+/*
+ * Collects the descriptors that can end the sleep of the dispatch lcore:
+ * the wakeup eventfd for the control socket and the descriptors of the
+ * ports that have one, whose net_port goes in the same slot of woken.
+ * Eth, KNI, ring and vhost ports cannot signal their packets, they are
+ * polled again once their backoff ends, so the sleep never outlasts the
+ * shortest idle_us of those ports.
+ */
+static int
+dispatch_idle_fds(struct dispatch_table *table, struct pollfd *pfds,
+		  struct net_port **woken)
+{
+	struct rte_port *rte_port;
+	int i, fd, n = 0;
+
+	pfds[n].fd = wakeup_fd;
+	pfds[n].events = POLLIN;
+	woken[n++] = NULL;
+
+	for (i = 0; table && i < table->nr_ports; i++) {
+		rte_port = table->ports[i]->rte_port;
+		if (rte_port->ops.rx_fd == NULL)
+			continue;
+		fd = rte_port->ops.rx_fd(rte_port);
+		if (fd < 0)
+			continue;
+		pfds[n].fd = fd;
+		pfds[n].events = POLLIN;
+		woken[n++] = table->ports[i];
+	}
+	return n;
+}
+
+/*
+ * Waits until the TSC reaches until, or until one of pfds is readable.
+ * The ports found readable are polled on the next round whatever their
+ * backoff; net_ports are never freed, so woken outlives the table.
+ */
+static void
+dispatch_idle(uint64_t now, uint64_t until, struct pollfd *pfds,
+	      struct net_port **woken, int n)
+{
+	struct timespec ts;
+	uint64_t us = (until - now) / tsc_per_us;
+	uint64_t val;
+	int i;
+
+	if (us < POLL_SLEEP_MIN_US || wakeup_fd < 0) {
+		while (rte_rdtsc() < until)
+			rte_pause();
+		return;
+	}
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (us % 1000000) * 1000;
+
+	if (ppoll(pfds, n, &ts, NULL) <= 0)
+		return;
+
+	for (i = 1; i < n; i++)
+		if (pfds[i].revents & POLLIN)
+			woken[i]->poll.next_tsc = 0;
+
+	if (pfds[0].revents & POLLIN)
+		if (read(wakeup_fd, &val, sizeof(val)) < 0)
+			return;
+}
+
+void
+dispatch_wakeup(void)
+{
+	uint64_t val = 1;
+
+	if (wakeup_fd >= 0)
+		if (write(wakeup_fd, &val, sizeof(val)) < 0)
+			return;
+}
+
+static void
+dispatch_input(struct net_port *net_port,
+	       struct rte_mbuf **pkts, uint32_t n_pkts, uint64_t now)
+{
+	struct netif *netif = net_port->netif;
+
+	if (unlikely(mempool_rx_low(net_port->rte_port))) {
+		n_pkts = mempool_rx_shed(net_port->rte_port, pkts, n_pkts);
+		if (n_pkts == 0)
+			return;
+	}
+
+	if (!netif) {
+		dispatch_to_bridge(net_port, pkts, n_pkts);
+		return;
+	}
+
+	n_pkts = ipfrag_reassemble_burst(pkts, n_pkts, now);
+	n_pkts = udp_mbuf_input_burst(netif, pkts, n_pkts);
+	if (n_pkts == 0)
+		return;
+
+	switch (net_port->rte_port_type) {
+	case RTE_PORT_TYPE_ETH:
+		dispatch_to_ethif(netif, pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_KNI:
+		dispatch_to_kniif(netif, pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_RING:
+		dispatch_to_ringif(netif, pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_TAP:
+		dispatch_to_tapif(netif, pkts, n_pkts);
+		break;
+	default:
+		rte_panic("Invalid port type\n");
+	}
+}
+
+/*
+ * Weighted scheduling of the ports: a port gets up to credit bursts per
+ * round, where credit adapts between 1 and the configured weight to the
+ * RX queue occupancy seen when the port used up its credit. A port that
+ * keeps returning nothing skips an exponentially growing number of
+ * rounds, up to SCHED_SKIP_MAX.
+ */
+static inline void
+dispatch_sched_update(struct net_port *net_port, uint32_t n_pkts,
+		      uint32_t bursts, int full, uint32_t burst)
+{
+	struct net_sched *sched = &net_port->sched;
+	struct rte_port *rte_port = net_port->rte_port;
+	uint32_t weight = net_port->net.weight ? : 1;
+	uint32_t pending;
+
+	if (n_pkts == 0) {
+		if (sched->idle_rounds < SCHED_SKIP_SHIFT_MAX)
+			sched->idle_rounds++;
+		sched->skip = RTE_MIN((1U << sched->idle_rounds) - 1,
+				      SCHED_SKIP_MAX);
+		sched->credit = 1;
+		return;
+	}
+
+	sched->idle_rounds = 0;
+	sched->skip = 0;
+
+	if (!full) {
+		/* drained before the credit ran out */
+		if (bursts < sched->credit)
+			sched->credit = RTE_MAX(bursts, 1U);
+		return;
+	}
+
+	if (weight == 1) {
+		/* no room to grow, spare the descriptor ring walk */
+		sched->credit = 1;
+		return;
+	}
+
+	if (rte_port->ops.rx_pending) {
+		pending = rte_port->ops.rx_pending(rte_port);
+		sched->credit = (pending + burst - 1) / burst;
+	} else {
+		sched->credit++;
+	}
+	sched->credit = RTE_MAX(RTE_MIN(sched->credit, weight), 1U);
+}
+
+static struct dispatch_table *
+dispatch_table_copy(void)
+{
+	struct dispatch_table *table;
+
+	table = rte_zmalloc("DISPATCH", sizeof(*table), CACHE_LINE_SIZE);
+	if (table == NULL) {
+		RTE_LOG(ERR, APP, "Cannot allocate dispatch table\n");
+		return NULL;
+	}
+	if (dispatch_table)
+		*table = *dispatch_table;
+	return table;
+}
+
+int
+dispatch_add_port(struct net_port *net_port)
+{
+	struct dispatch_table *table;
+
+	if (dispatch_table && dispatch_table->nr_ports >= DISPATCH_PORT_MAX)
+		return -1;
+
+	table = dispatch_table_copy();
+	if (table == NULL)
+		return -1;
+
+	memset(&net_port->poll, 0, sizeof(net_port->poll));
+	memset(&net_port->sched, 0, sizeof(net_port->sched));
+	table->ports[table->nr_ports++] = net_port;
+
+	rcu_free(dispatch_table);
+	rcu_assign(dispatch_table, table);
+	return 0;
+}
+
+int
+dispatch_del_port(struct net_port *net_port)
+{
+	struct dispatch_table *table;
+	int i, n = 0;
+
+	table = dispatch_table_copy();
+	if (table == NULL)
+		return -1;
+
+	for (i = 0; i < table->nr_ports; i++) {
+		if (table->ports[i] != net_port)
+			table->ports[n++] = table->ports[i];
+	}
+	if (n == table->nr_ports) {
+		rte_free(table);
+		return -1;
+	}
+	table->nr_ports = n;
+
+	rcu_free(dispatch_table);
+	rcu_assign(dispatch_table, table);
+	return 0;
+}
+
 static int
-dispatch(struct net_port *ports, int nr_ports,
-	 struct rte_mbuf **pkts, int pkt_burst_sz)
+dispatch(struct rte_mbuf **pkts, int pkt_burst_sz)
 {
+	struct dispatch_table *table;
 	struct net_port *net_port;
 	struct rte_port *rte_port;
-	struct netif *netif;
 	int i;
-	uint32_t n_pkts;
+	uint32_t n_pkts, total, bursts, burst;
+	uint64_t now = rte_rdtsc();
+	uint64_t idle_until = UINT64_MAX;
+	struct pollfd pfds[DISPATCH_PORT_MAX + 1];
+	struct net_port *woken[DISPATCH_PORT_MAX + 1];
+	int nr_pfds = 0;
 
-	/*
-	 * From lwip/src/core/timers.c:
-	 *
-	 * "Must be called periodically from your main loop."
-	 */
-	sys_check_timeouts();
+	wheel_poll(now);
+	ctl_poll();
 
-	for (i = 0; i < nr_ports; i++) {
-		net_port = &ports[i];
+	table = rcu_dereference(dispatch_table);
+	for (i = 0; table && i < table->nr_ports; i++) {
+		net_port = table->ports[i];
 		rte_port = net_port->rte_port;
 
-		n_pkts = rte_port->ops.rx_burst(rte_port, pkts, pkt_burst_sz);
-		if (unlikely(n_pkts > pkt_burst_sz))
+		if (net_port->poll.next_tsc > now) {
+			idle_until = RTE_MIN(idle_until, net_port->poll.next_tsc);
 			continue;
+		}
 
-		if (n_pkts == 0)
+		if (net_port->sched.skip) {
+			net_port->sched.skip--;
+			idle_until = now;
 			continue;
+		}
 
-		netif = net_port->netif;
-		if (!netif) {
-			dispatch_to_bridge(net_port, pkts, n_pkts);
-		} else {
-			switch (net_port->rte_port_type) {
-			case RTE_PORT_TYPE_ETH:
-				dispatch_to_ethif(netif, pkts, n_pkts);
-				break;
-			case RTE_PORT_TYPE_KNI:
-				dispatch_to_kniif(netif, pkts, n_pkts);
+		/* the burst size of each port, up to pkt_burst_sz */
+		burst = net_port->net.burst ? : PKT_BURST_SZ;
+		burst = RTE_MIN(burst, (uint32_t)pkt_burst_sz);
+
+		total = bursts = 0;
+		do {
+			CYCLES_BEGIN(rx_tsc);
+			n_pkts = rte_port->ops.rx_burst(rte_port, pkts, burst);
+			if (unlikely(n_pkts > burst))
 				break;
-			default:
-				rte_panic("Invalid port type\n");
+			CYCLES_END(CYCLES_RX, rx_tsc, n_pkts);
+
+			bursts++;
+			total += n_pkts;
+
+			if (n_pkts > 0) {
+				trace(TRACE_RX_BURST, 0, rte_port->stats_id,
+				      n_pkts);
+				dispatch_input(net_port, pkts, n_pkts, now);
 			}
-		}
+		} while (n_pkts == burst &&
+			 bursts < net_port->sched.credit);
+
+		dispatch_sched_update(net_port, total, bursts,
+				      n_pkts == burst, burst);
+
+		idle_until = RTE_MIN(idle_until,
+				     dispatch_poll_update(net_port, total, now));
+	}
+
+	if (unlikely(idle_until > now))
+		nr_pfds = dispatch_idle_fds(table, pfds, woken);
+
+	/* no table is used past this point */
+	rcu_quiescent();
+
+	/* every port backs off, sleep until one or a timer is due */
+	if (unlikely(idle_until > now)) {
+		idle_until = RTE_MIN(idle_until, wheels[rte_lcore_id()].next_tsc);
+		if (idle_until > now && idle_until != UINT64_MAX)
+			dispatch_idle(now, idle_until, pfds, woken,
+				      nr_pfds);
 	}
 	return 0;
 }
 
+/*
+ * From lwip/src/core/timers.c:
+ *
+ * "Must be called periodically from your main loop."
+ *
+ * None of the lwIP timers is shorter than LWIP_TIMER_MS, so they are
+ * checked from the timer wheel instead of on every iteration.
+ */
+static void
+lwip_timer_cb(struct wheel_timer *timer, void *arg)
+{
+	sys_check_timeouts();
+}
+
 int
-dispatch_thread(struct net_port *ports, int nr_ports, int pkt_burst_sz)
+dispatch_thread(int pkt_burst_sz)
 {
 	struct rte_mbuf *pkts[pkt_burst_sz];
+	struct wheel_timer lwip_timer;
 	int ret = 0;
 
-	while (!ret) {
-		ret = dispatch(ports, nr_ports, pkts, pkt_burst_sz);
+	tsc_per_us = rte_get_tsc_hz() / 1000000;
+
+	wakeup_fd = eventfd(0, EFD_NONBLOCK);
+	if (wakeup_fd < 0)
+		RTE_LOG(WARNING, APP, "Cannot create wakeup eventfd\n");
+
+	wheel_timer_init(&lwip_timer);
+	wheel_timer_start(&lwip_timer, LWIP_TIMER_MS, LWIP_TIMER_MS,
+			  lwip_timer_cb, NULL);
+
+	rcu_online();
+	while (!ret && !dispatch_quit) {
+		ret = dispatch(pkts, pkt_burst_sz);
 	}
+	rcu_offline();
+
+	wheel_timer_stop(&lwip_timer);
 	return ret;
 }
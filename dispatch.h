@@ -35,7 +35,37 @@
 
 #include "port.h"
 
+/* Interval of sys_check_timeouts() */
+#define LWIP_TIMER_MS		10
+
+/* Number of consecutive empty polls before an adaptive port backs off */
+#define POLL_IDLE_THRESHOLD	64
+
+/* Default max polling delay of an idle adaptive port */
+#define POLL_IDLE_US_DEFAULT	100
+
+/* Shorter idle periods are spent in rte_pause() rather than sleeping */
+#define POLL_SLEEP_MIN_US	20
+
+/* Max number of rounds an idle port is skipped */
+#define SCHED_SKIP_SHIFT_MAX	3
+#define SCHED_SKIP_MAX		((1U << SCHED_SKIP_SHIFT_MAX) - 1)
+
+/* Max number of ports polled by the dispatch loop */
+#define DISPATCH_PORT_MAX	16
+
+struct dispatch_table {
+	int			 nr_ports;
+	struct net_port		*ports[DISPATCH_PORT_MAX];
+};
+
 int ip_input_hook(struct pbuf *p, struct netif *inp);
-int dispatch_thread(struct net_port *ports, int nr_ports, int pkt_burst_sz);
+int dispatch_add_port(struct net_port *net_port);
+int dispatch_del_port(struct net_port *net_port);
+int dispatch_thread(int pkt_burst_sz);
+void dispatch_wakeup(void);
+
+/* set to leave dispatch_thread() */
+extern volatile int dispatch_quit;
 
 #endif
@@ -43,15 +43,17 @@
 #include <rte_malloc.h>
 #include <rte_memcpy.h>
 
+#include "convert.h"
 #include "ethif.h"
-#include "mempool.h"
+#include "ipfrag.h"
+#include "stats.h"
 
 struct ethif *
 ethif_alloc(int socket_id)
 {
 	struct ethif *ethif;
 
-	ethif = rte_zmalloc_socket("ETHIF", sizeof(ethif), CACHE_LINE_SIZE,
+	ethif = rte_zmalloc_socket("ETHIF", sizeof(*ethif), CACHE_LINE_SIZE,
 				   socket_id);
 	return ethif;
 }
@@ -67,6 +69,7 @@ ethif_init(struct ethif *ethif, struct rte_port_eth_params *params,
 		return ERR_MEM;
 
 	memset(&ethif->netif, 0, sizeof(ethif->netif));
+	ethif->netif.state = ethif;
 
 	net_port->netif = &ethif->netif;
 	RTE_VERIFY(net_port->rte_port == &ethif->eth_port->rte_port);
@@ -81,26 +84,28 @@ ethif_init(struct ethif *ethif, struct rte_port_eth_params *params,
 err_t
 ethif_input(struct ethif *ethif, struct rte_mbuf *m)
 {
-	int len = rte_pktmbuf_pkt_len(m);
-	char *dat = rte_pktmbuf_mtod(m, char *);
-	struct pbuf *p, *q;
+	struct pbuf *p;
+	err_t err;
 
 	RTE_VERIFY(ethif->rte_port_type == RTE_PORT_TYPE_ETH);
 
-	p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+	latency_record(rte_port_latency_local(&ethif->eth_port->rte_port), m,
+		       rte_rdtsc());
+
+	CYCLES_BEGIN(tsc);
+	p = mbuf_to_pbuf(m);
+	rte_pktmbuf_free(m);
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
 	if (p == 0) {
-		rte_pktmbuf_free(m);
-		ethif->eth_port->rte_port.stats.rx_dropped += 1;
+		rte_port_drop(&ethif->eth_port->rte_port, DROP_RX_PBUF, 1);
 		return ERR_OK;
 	}
 
-	for(q = p; q != NULL; q = q->next) {
-		rte_memcpy(q->payload, dat, q->len);
-		dat += q->len;
-	}
-	rte_pktmbuf_free(m);
+	CYCLES_BEGIN(lwip_tsc);
+	err = ethif->netif.input(p, &ethif->netif);
+	CYCLES_END(CYCLES_LWIP, lwip_tsc, 1);
 
-	return ethif->netif.input(p, &ethif->netif);
+	return err;
 }
 
 /* buffer ownership and responsivity [if_output]
@@ -113,27 +118,28 @@ low_level_output(struct netif *netif, struct pbuf *p)
 {
 	struct ethif *ethif = (struct ethif *)netif->state;
 	struct rte_port_eth *eth_port;
-	struct rte_mbuf *m;
-	struct pbuf *q;
+	struct rte_mbuf *m, *frags[IPFRAG_MAX_FRAGS];
+	int n;
 
 	RTE_VERIFY(ethif->rte_port_type == RTE_PORT_TYPE_ETH);
 
 	eth_port = ethif->eth_port;
 
-	m = rte_pktmbuf_alloc(pktmbuf_pool);
-	if (m == NULL)
+	CYCLES_BEGIN(tsc);
+	m = pbuf_to_mbuf(p, eth_port->rte_port.mempool);
+	if (m == NULL) {
+		rte_port_drop(&eth_port->rte_port, DROP_TX_MBUF, 1);
 		return ERR_MEM;
+	}
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
 
-	for(q = p; q != NULL; q = q->next) {
-		char *data = rte_pktmbuf_append(m, q->len);
-		if (data == NULL) {
-			rte_pktmbuf_free(m);
-			return ERR_MEM;
-		}
-		rte_memcpy(data, q->payload, q->len);
+	n = ipfrag_fragment(m, netif->mtu, frags, IPFRAG_MAX_FRAGS);
+	if (n < 0) {
+		rte_port_drop(&eth_port->rte_port, DROP_TX_FRAG, 1);
+		return ERR_MEM;
 	}
 
-	rte_port_eth_tx_burst(&eth_port->rte_port, &m, 1);
+	rte_port_eth_tx_burst(&eth_port->rte_port, frags, n);
 
 	return ERR_OK;
 }
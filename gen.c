@@ -0,0 +1,319 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rte_byteorder.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+#include <rte_udp.h>
+
+#include <lwip/inet_chksum.h>
+
+#include "bridge.h"
+#include "gen.h"
+#include "main.h"
+#include "mempool.h"
+
+/* Writes Ethernet, IPv4 and UDP headers for a payload of len bytes */
+static uint8_t *
+gen_headers(uint8_t *p, struct ether_addr *src_mac,
+	    struct ether_addr *dst_mac, uint32_t src_ip, uint32_t dst_ip,
+	    uint16_t src_port, uint16_t dst_port, uint16_t len)
+{
+	struct ether_hdr *eth = (struct ether_hdr *)p;
+	struct ipv4_hdr *ip = (struct ipv4_hdr *)(eth + 1);
+	struct udp_hdr *udp = (struct udp_hdr *)(ip + 1);
+
+	ether_addr_copy(dst_mac, &eth->d_addr);
+	ether_addr_copy(src_mac, &eth->s_addr);
+	eth->ether_type = rte_cpu_to_be_16(ETHER_TYPE_IPv4);
+
+	memset(ip, 0, sizeof(*ip));
+	ip->version_ihl = 0x45;
+	ip->total_length = rte_cpu_to_be_16(sizeof(*ip) + sizeof(*udp) + len);
+	ip->time_to_live = 64;
+	ip->next_proto_id = IPPROTO_UDP;
+	ip->src_addr = src_ip;
+	ip->dst_addr = dst_ip;
+	ip->hdr_checksum = inet_chksum(ip, sizeof(*ip));
+
+	/* no UDP checksum, as allowed over IPv4 */
+	udp->src_port = rte_cpu_to_be_16(src_port);
+	udp->dst_port = rte_cpu_to_be_16(dst_port);
+	udp->dgram_len = rte_cpu_to_be_16(sizeof(*udp) + len);
+	udp->dgram_cksum = 0;
+
+	return (uint8_t *)(udp + 1);
+}
+
+/* Spread over the slots so that no kind comes in long runs */
+#define GEN_SCHED_STRIDE	37
+
+struct gen_arp {
+	uint16_t		 hrd;
+	uint16_t		 pro;
+	uint8_t			 hln;
+	uint8_t			 pln;
+	uint16_t		 op;
+	struct ether_addr	 sha;
+	uint32_t		 spa;
+	struct ether_addr	 tha;
+	uint32_t		 tpa;
+} __attribute__((__packed__));
+
+static struct ether_addr gen_bcast_mac = {{
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+}};
+
+static void
+gen_arp_frame(struct gen_conf *conf, struct gen_tmpl *t)
+{
+	struct ether_hdr *eth = (struct ether_hdr *)t->data;
+	struct gen_arp *arp = (struct gen_arp *)(eth + 1);
+
+	ether_addr_copy(&gen_bcast_mac, &eth->d_addr);
+	ether_addr_copy(&conf->src_mac, &eth->s_addr);
+	eth->ether_type = rte_cpu_to_be_16(ETHER_TYPE_ARP);
+
+	arp->hrd = rte_cpu_to_be_16(1);
+	arp->pro = rte_cpu_to_be_16(ETHER_TYPE_IPv4);
+	arp->hln = ETHER_ADDR_LEN;
+	arp->pln = sizeof(uint32_t);
+	arp->op = rte_cpu_to_be_16(1);
+	ether_addr_copy(&conf->src_mac, &arp->sha);
+	arp->spa = conf->src_ip;
+	arp->tpa = conf->dst_ip;
+}
+
+static void
+gen_udp_frame(struct gen_conf *conf, struct gen_tmpl *t, gen_kind kind,
+	      uint16_t frame_size)
+{
+	uint16_t inner_len = frame_size - GEN_CRC_LEN;
+	uint16_t hdr_len = sizeof(struct ether_hdr) + sizeof(struct ipv4_hdr) +
+		sizeof(struct udp_hdr);
+	struct ether_addr *dst_mac = &conf->dst_mac;
+	uint32_t dst_ip = conf->dst_ip;
+	struct vxlanhdr *vxlan;
+	uint8_t *p = t->data;
+	int i = 0;
+
+	if (kind == GEN_VXLAN) {
+		t->port_off[i++] = hdr_len - sizeof(struct udp_hdr);
+		p = gen_headers(p, &conf->outer_src_mac, &conf->outer_dst_mac,
+				conf->outer_src_ip, conf->outer_dst_ip,
+				conf->src_port, VXLAN_DST_PORT,
+				sizeof(*vxlan) + inner_len);
+		vxlan = (struct vxlanhdr *)p;
+		vxlan->vx_flags = rte_cpu_to_be_32(VXLAN_FLAGS_I);
+		vxlan->vx_vni = rte_cpu_to_be_32(VXLAN_VNI);
+		p += sizeof(*vxlan);
+	} else if (kind == GEN_BCAST) {
+		dst_mac = &gen_bcast_mac;
+		dst_ip = 0xffffffff;
+	}
+
+	t->port_off[i] = (p - t->data) + hdr_len - sizeof(struct udp_hdr);
+	p = gen_headers(p, &conf->src_mac, dst_mac,
+			conf->src_ip, dst_ip, conf->src_port, conf->dst_port,
+			inner_len - hdr_len);
+	memset(p, 0xa5, inner_len - hdr_len);
+}
+
+static int
+gen_tmpl_init(struct gen *gen, gen_kind kind, int size, int socket_id)
+{
+	struct gen_conf *conf = &gen->conf;
+	struct gen_tmpl *t = &gen->tmpls[kind][size];
+	uint16_t frame_size;
+
+	frame_size = kind == GEN_ARP ? GEN_FRAME_MIN :
+		conf->mix.frame_sizes[size];
+
+	t->len = frame_size - GEN_CRC_LEN;
+	if (kind == GEN_VXLAN)
+		t->len += sizeof(struct ether_hdr) + sizeof(struct ipv4_hdr) +
+			sizeof(struct udp_hdr) + sizeof(struct vxlanhdr);
+
+	/* gen_burst() copies a template into a single mbuf */
+	if (t->len > mempool_conf.data_room) {
+		RTE_LOG(ERR, APP, "Generated frame of %u bytes does not fit "
+			"an mbuf, see -m size\n", t->len);
+		return -1;
+	}
+
+	t->data = rte_zmalloc_socket("GEN", t->len, CACHE_LINE_SIZE,
+				     socket_id);
+	if (t->data == NULL)
+		return -1;
+
+	if (kind == GEN_ARP)
+		gen_arp_frame(conf, t);
+	else
+		gen_udp_frame(conf, t, kind, frame_size);
+	return 0;
+}
+
+/* Lays the kinds out over the slots, as many slots as their percent */
+static void
+gen_sched_init(struct gen *gen, uint8_t *pct)
+{
+	uint32_t slot, pos, base;
+	int kind;
+
+	for (slot = 0; slot < GEN_SCHED_LEN; slot++) {
+		pos = slot * GEN_SCHED_STRIDE % GEN_SCHED_LEN;
+		for (kind = 0, base = 0; pos >= base + pct[kind]; kind++)
+			base += pct[kind];
+		gen->sched[slot] = kind;
+	}
+}
+
+/* Parses sizes separated by '/', as ',' separates the options */
+int
+gen_parse_sizes(struct gen_mix *mix, char *list)
+{
+	char *size, *save = NULL;
+
+	mix->nr_sizes = 0;
+	for (size = strtok_r(list, "/", &save); size != NULL;
+	     size = strtok_r(NULL, "/", &save)) {
+		if (mix->nr_sizes >= GEN_SIZES_MAX)
+			return -1;
+		mix->frame_sizes[mix->nr_sizes++] = rte_str_to_size(size);
+	}
+	return mix->nr_sizes ? 0 : -1;
+}
+
+int
+gen_init(struct gen *gen, struct gen_conf *conf,
+	 struct rte_mempool *mp, int socket_id)
+{
+	struct gen_mix *mix = &conf->mix;
+	uint8_t pct[GEN_KIND_MAX];
+	int kind, size;
+
+	if (mix->nr_sizes == 0 || mix->nr_sizes > GEN_SIZES_MAX)
+		return -1;
+	for (size = 0; size < mix->nr_sizes; size++) {
+		if (mix->frame_sizes[size] < GEN_FRAME_MIN ||
+		    mix->frame_sizes[size] > GEN_FRAME_MAX)
+			return -1;
+	}
+	if (mix->arp_pct + mix->bcast_pct + mix->vxlan_pct > 100)
+		return -1;
+	if (mix->nr_flows == 0 || mix->nr_flows > GEN_FLOWS_MAX)
+		mix->nr_flows = 1;
+
+	memset(gen, 0, sizeof(*gen));
+	gen->conf = *conf;
+	gen->mp = mp;
+
+	pct[GEN_UNICAST] = 100 - mix->arp_pct - mix->bcast_pct -
+		mix->vxlan_pct;
+	pct[GEN_BCAST] = mix->bcast_pct;
+	pct[GEN_VXLAN] = mix->vxlan_pct;
+	pct[GEN_ARP] = mix->arp_pct;
+
+	for (kind = 0; kind < GEN_KIND_MAX; kind++) {
+		if (pct[kind] == 0)
+			continue;
+		for (size = 0; size < mix->nr_sizes; size++) {
+			if (gen_tmpl_init(gen, kind, size, socket_id) != 0)
+				return -1;
+			if (kind == GEN_ARP)
+				break;
+		}
+	}
+
+	gen_sched_init(gen, pct);
+
+	return 0;
+}
+
+/*
+ * Copies the templates into newly allocated mbufs following the mix,
+ * sizes and flows in turn. The flow is set by the UDP source ports.
+ */
+uint32_t
+gen_burst(struct gen *gen, struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct gen_mix *mix = &gen->conf.mix;
+	struct gen_tmpl *t;
+	struct rte_mbuf *m;
+	uint16_t port;
+	uint8_t *dat;
+	uint32_t i;
+	int kind;
+
+	for (i = 0; i < n_pkts; i++) {
+		m = rte_pktmbuf_alloc(gen->mp);
+		if (m == NULL)
+			break;
+
+		kind = gen->sched[gen->next];
+		t = &gen->tmpls[kind][kind == GEN_ARP ? 0 : gen->size];
+
+		dat = rte_pktmbuf_mtod(m, uint8_t *);
+		rte_memcpy(dat, t->data, t->len);
+		m->pkt.data_len = t->len;
+		m->pkt.pkt_len = t->len;
+		pkts[i] = m;
+
+		if (kind != GEN_ARP) {
+			/* no UDP checksum to update */
+			port = rte_cpu_to_be_16(gen->conf.src_port + gen->flow);
+			*(uint16_t *)(dat + t->port_off[0]) = port;
+			if (t->port_off[1])
+				*(uint16_t *)(dat + t->port_off[1]) = port;
+
+			if (++gen->size >= mix->nr_sizes)
+				gen->size = 0;
+			if (++gen->flow >= mix->nr_flows)
+				gen->flow = 0;
+		}
+		if (++gen->next >= GEN_SCHED_LEN)
+			gen->next = 0;
+
+		gen->bytes += t->len;
+	}
+
+	gen->pkts += i;
+
+	return i;
+}
@@ -0,0 +1,113 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _GEN_H_
+#define _GEN_H_
+
+#include <stdint.h>
+
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+/* Frame sizes include the Ethernet CRC, as on the wire */
+#define GEN_FRAME_MIN		64
+#define GEN_FRAME_MAX		1518
+#define GEN_CRC_LEN		4
+
+/* Number of UDP flows the frames are spread on, by source port */
+#define GEN_FLOWS_MAX		256
+
+#define GEN_SIZES_MAX		8
+
+/* The mix is laid out over this many slots, one per percent */
+#define GEN_SCHED_LEN		100
+
+typedef enum {
+	GEN_UNICAST = 0,	/* UDP to dst_ip */
+	GEN_BCAST,		/* UDP to the broadcast MAC and IP */
+	GEN_VXLAN,		/* unicast UDP encapsulated into VXLAN */
+	GEN_ARP,		/* ARP request for dst_ip */
+	GEN_KIND_MAX,
+} gen_kind;
+
+struct gen_mix {
+	uint16_t		 frame_sizes[GEN_SIZES_MAX];
+	uint16_t		 nr_sizes;	/* taken in turn */
+	uint16_t		 nr_flows;
+	/* percent of the frames, the rest is unicast */
+	uint8_t			 arp_pct;
+	uint8_t			 bcast_pct;
+	uint8_t			 vxlan_pct;
+};
+
+struct gen_conf {
+	struct gen_mix		 mix;		/* inner frames with VXLAN */
+	struct ether_addr	 src_mac;
+	struct ether_addr	 dst_mac;
+	uint32_t		 src_ip;	/* network order */
+	uint32_t		 dst_ip;
+	uint16_t		 src_port;	/* host order */
+	uint16_t		 dst_port;
+
+	/* outer headers of the VXLAN frames */
+	struct ether_addr	 outer_src_mac;
+	struct ether_addr	 outer_dst_mac;
+	uint32_t		 outer_src_ip;
+	uint32_t		 outer_dst_ip;
+};
+
+/* One template per kind and size; ARP only has one size */
+struct gen_tmpl {
+	uint8_t			*data;
+	uint16_t		 len;		/* without CRC */
+	uint16_t		 port_off[2];	/* UDP source ports, or 0 */
+};
+
+struct gen {
+	struct gen_conf		 conf;
+	struct rte_mempool	*mp;
+	struct gen_tmpl		 tmpls[GEN_KIND_MAX][GEN_SIZES_MAX];
+	uint8_t			 sched[GEN_SCHED_LEN];	/* gen_kind */
+	uint32_t		 next;
+	uint16_t		 size;
+	uint16_t		 flow;
+	uint64_t		 pkts;
+	uint64_t		 bytes;
+};
+
+int gen_parse_sizes(struct gen_mix *mix, char *list);
+int gen_init(struct gen *gen, struct gen_conf *conf,
+	     struct rte_mempool *mp, int socket_id);
+uint32_t gen_burst(struct gen *gen, struct rte_mbuf **pkts, uint32_t n_pkts);
+
+#endif
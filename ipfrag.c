@@ -0,0 +1,208 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+
+#include <lwip/inet_chksum.h>
+
+#include "ipfrag.h"
+#include "latency.h"
+#include "main.h"
+#include "mempool.h"
+
+struct ipfrag_lcore {
+	struct rte_ip_frag_tbl		*tbl;
+	struct rte_ip_frag_death_row	 death_row;
+} __rte_cache_aligned;
+
+static struct ipfrag_lcore ipfrag_lcores[RTE_MAX_LCORE];
+
+int
+ipfrag_init(void)
+{
+	uint64_t max_cycles;
+	unsigned lcore_id;
+
+	max_cycles = (rte_get_tsc_hz() + 999) / 1000 * IPFRAG_TBL_TTL_MS;
+
+	RTE_LCORE_FOREACH(lcore_id) {
+		struct ipfrag_lcore *lc = &ipfrag_lcores[lcore_id];
+
+		lc->tbl = rte_ip_frag_table_create(IPFRAG_TBL_BUCKET_NUM,
+						   IPFRAG_TBL_BUCKET_ENTRIES,
+						   IPFRAG_TBL_MAX_ENTRIES,
+						   max_cycles,
+						   rte_lcore_to_socket_id(lcore_id));
+		if (lc->tbl == NULL) {
+			RTE_LOG(ERR, APP,
+				"Cannot create ip frag table on lcore %u\n",
+				lcore_id);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* buffer ownership and responsivity [reassemble_burst]
+ *   mbuf: fragments are kept in the table of the calling lcore until
+ *         the datagram is complete or expires; the burst is compacted
+ *         in place and the new number of packets is returned
+ */
+uint32_t
+ipfrag_reassemble_burst(struct rte_mbuf **pkts, uint32_t n_pkts, uint64_t tsc)
+{
+	struct ipfrag_lcore *lc = &ipfrag_lcores[rte_lcore_id()];
+	struct ether_hdr *eth;
+	struct ipv4_hdr *ip;
+	struct rte_mbuf *m;
+	uint32_t i, n = 0;
+
+	for (i = 0; i < n_pkts; i++) {
+		m = pkts[i];
+
+		if (unlikely(rte_pktmbuf_data_len(m) <
+			     sizeof(*eth) + sizeof(*ip))) {
+			pkts[n++] = m;
+			continue;
+		}
+
+		eth = rte_pktmbuf_mtod(m, struct ether_hdr *);
+		if (eth->ether_type != rte_cpu_to_be_16(ETHER_TYPE_IPv4)) {
+			pkts[n++] = m;
+			continue;
+		}
+
+		ip = (struct ipv4_hdr *)(eth + 1);
+		if (likely(!rte_ipv4_frag_pkt_is_fragmented(ip))) {
+			pkts[n++] = m;
+			continue;
+		}
+
+		m->pkt.vlan_macip.f.l2_len = sizeof(*eth);
+		m->pkt.vlan_macip.f.l3_len =
+			(ip->version_ihl & IPV4_HDR_IHL_MASK) *
+			IPV4_IHL_MULTIPLIER;
+
+		m = rte_ipv4_frag_reassemble_packet(lc->tbl, &lc->death_row,
+						    m, tsc, ip);
+		if (m == NULL)
+			continue;
+
+		/* the library leaves the header checksum to the NIC */
+		ip = (struct ipv4_hdr *)(rte_pktmbuf_mtod(m, char *) +
+					 m->pkt.vlan_macip.f.l2_len);
+		ip->hdr_checksum = 0;
+		ip->hdr_checksum = inet_chksum(ip, m->pkt.vlan_macip.f.l3_len);
+		pkts[n++] = m;
+	}
+
+	if (lc->death_row.cnt)
+		rte_ip_frag_free_death_row(&lc->death_row,
+					   IPFRAG_PREFETCH_OFFSET);
+
+	return n;
+}
+
+/* buffer ownership and responsivity [fragment]
+ *   mbuf: the ownership of m is always taken; on success the caller owns
+ *         all of the returned fragments, which reference the payload of
+ *         m through indirect mbufs
+ */
+int
+ipfrag_fragment(struct rte_mbuf *m, uint16_t mtu,
+		struct rte_mbuf **frags, uint16_t nb_frags)
+{
+	struct ether_hdr eth, *hdr;
+	struct ipv4_hdr *ip;
+	uint64_t tsc;
+	int32_t n, i;
+
+	if (likely(rte_pktmbuf_pkt_len(m) <= mtu + sizeof(eth))) {
+		frags[0] = m;
+		return 1;
+	}
+
+	eth = *rte_pktmbuf_mtod(m, struct ether_hdr *);
+	if (eth.ether_type != rte_cpu_to_be_16(ETHER_TYPE_IPv4)) {
+		rte_pktmbuf_free(m);
+		return -EINVAL;
+	}
+	rte_pktmbuf_adj(m, sizeof(eth));
+	tsc = mbuf_tsc(m);
+
+	/* the fragments are attached to the segments of m, which have to
+	 * be direct in DPDK 1.7
+	 */
+	if (mempool_has_indirect(m)) {
+		struct rte_mbuf *copy = mempool_copy(m, pktmbuf_pool);
+
+		rte_pktmbuf_free(m);
+		if (copy == NULL)
+			return -ENOMEM;
+		m = copy;
+	}
+
+	n = rte_ipv4_fragment_packet(m, frags, nb_frags, mtu,
+				     pktmbuf_pool, indirect_pool);
+	rte_pktmbuf_free(m);
+	if (n < 0)
+		return n;
+
+	for (i = 0; i < n; i++) {
+		ip = rte_pktmbuf_mtod(frags[i], struct ipv4_hdr *);
+		ip->hdr_checksum = 0;
+		ip->hdr_checksum = inet_chksum(ip,
+			(ip->version_ihl & IPV4_HDR_IHL_MASK) *
+			IPV4_IHL_MULTIPLIER);
+
+		hdr = (struct ether_hdr *)rte_pktmbuf_prepend(frags[i],
+							      sizeof(*hdr));
+		if (hdr == NULL) {
+			for (i = 0; i < n; i++)
+				rte_pktmbuf_free(frags[i]);
+			return -ENOMEM;
+		}
+		*hdr = eth;
+		mbuf_tsc_set(frags[i], tsc);
+	}
+	return n;
+}
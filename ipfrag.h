@@ -0,0 +1,60 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _IPFRAG_H_
+#define _IPFRAG_H_
+
+#include <rte_ip_frag.h>
+#include <rte_mbuf.h>
+
+/* Number of buckets and entries of the per-lcore reassembly table */
+#define IPFRAG_TBL_BUCKET_NUM		4096
+#define IPFRAG_TBL_BUCKET_ENTRIES	16
+#define IPFRAG_TBL_MAX_ENTRIES		IPFRAG_TBL_BUCKET_NUM
+
+/* How long a datagram waits for all of its fragments (same as lwIP's
+ * IP_REASS_MAXAGE) */
+#define IPFRAG_TBL_TTL_MS		3000
+
+/* Prefetch window used when freeing the death row */
+#define IPFRAG_PREFETCH_OFFSET		3
+
+/* Max number of fragments an outgoing packet is split into */
+#define IPFRAG_MAX_FRAGS		RTE_LIBRTE_IP_FRAG_MAX_FRAG
+
+int ipfrag_init(void);
+uint32_t ipfrag_reassemble_burst(struct rte_mbuf **pkts, uint32_t n_pkts,
+				 uint64_t tsc);
+int ipfrag_fragment(struct rte_mbuf *m, uint16_t mtu,
+		    struct rte_mbuf **frags, uint16_t nb_frags);
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+
+/* Bucket b counts latencies in [2^b, 2^(b+1)) TSC cycles, the last one
+ * everything above */
+#define LATENCY_BUCKETS		32
+
+struct latency_hist {
+	uint64_t	buckets[LATENCY_BUCKETS];
+};
+
+/*
+ * The RX TSC of a packet is kept in the first bytes of the headroom, so
+ * it is shared by the clones attached to the buffer and survives as
+ * long as the headroom is not used up by prepended headers. Paths
+ * allocating mbufs of their own reset it.
+ */
+static inline void
+mbuf_tsc_set(struct rte_mbuf *m, uint64_t tsc)
+{
+	if (likely(rte_pktmbuf_headroom(m) >= sizeof(uint64_t)))
+		*(uint64_t *)m->buf_addr = tsc;
+}
+
+static inline uint64_t
+mbuf_tsc(struct rte_mbuf *m)
+{
+	if (unlikely(rte_pktmbuf_headroom(m) < sizeof(uint64_t)))
+		return 0;
+	return *(uint64_t *)m->buf_addr;
+}
+
+static inline void
+mbuf_tsc_set_burst(struct rte_mbuf **pkts, uint32_t n_pkts, uint64_t tsc)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_pkts; i++)
+		mbuf_tsc_set(pkts[i], tsc);
+}
+
+static inline void
+latency_record(struct latency_hist *hist, struct rte_mbuf *m, uint64_t now)
+{
+	uint64_t tsc = mbuf_tsc(m);
+	uint32_t b;
+
+	if (tsc == 0 || tsc > now)
+		return;
+
+	b = 63 - __builtin_clzll((now - tsc) | 1);
+	hist->buckets[b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1]++;
+}
+
+static inline void
+latency_record_burst(struct latency_hist *hist,
+		     struct rte_mbuf **pkts, uint32_t n_pkts, uint64_t now)
+{
+	uint32_t i;
+
+	for (i = 0; i < n_pkts; i++)
+		latency_record(hist, pkts[i], now);
+}
+
+#endif
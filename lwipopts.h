@@ -170,6 +170,12 @@
  */
 #define PBUF_POOL_SIZE                  32
 
+/**
+ * PBUF_POOL_BUFSIZE: the size of each pbuf in the pbuf pool. A standard
+ * frame fits in one, a 9000 byte jumbo frame takes six.
+ */
+#define PBUF_POOL_BUFSIZE               1536
+
 /*
    ---------------------------------
    ---------- ARP options ----------
@@ -180,6 +186,14 @@
  */
 #define LWIP_ARP                        1
 
+/**
+ * ETHARP_SUPPORT_STATIC_ENTRIES==1: enable code to support static ARP table
+ * entries (using etharp_add_static_entry/etharp_remove_static_entry).
+ *
+ * The benchmark pins the addresses of its peers with them.
+ */
+#define ETHARP_SUPPORT_STATIC_ENTRIES   1
+
 /*
    --------------------------------
    ---------- IP options ----------
@@ -203,15 +217,21 @@
  * IP_REASSEMBLY==1: Reassemble incoming fragmented IP packets. Note that
  * this option does not affect outgoing packet sizes, which can be controlled
  * via IP_FRAG.
+ *
+ * Disabled: fragments are reassembled on mbufs in ipfrag.c before they are
+ * handed to lwIP.
  */
-#define IP_REASSEMBLY                   1
+#define IP_REASSEMBLY                   0
 
 /**
  * IP_FRAG==1: Fragment outgoing IP packets if their size exceeds MTU. Note
  * that this option does not affect incoming packet sizes, which can be
  * controlled via IP_REASSEMBLY.
+ *
+ * Disabled: oversized packets are fragmented on mbufs in ipfrag.c by the
+ * netif output functions.
  */
-#define IP_FRAG                         1
+#define IP_FRAG                         0
 
 /**
  * IP_REASS_MAXAGE: Maximum time (in multiples of IP_TMR_INTERVAL - so seconds, normally)
@@ -402,6 +422,19 @@
  */
 #define LWIP_STATS                      0
 
+/*
+   ----------------------------------
+   ---------- Hook options ----------
+   ----------------------------------
+*/
+/**
+ * LWIP_HOOK_IP4_ROUTE(dest): static routes of the control socket, see
+ * route.h
+ */
+struct ip_addr;
+struct netif *route_lookup(struct ip_addr *dest);
+#define LWIP_HOOK_IP4_ROUTE(dest)       route_lookup(dest)
+
 /* Misc */
 
 #endif /* __LWIPOPTS_H__ */
@@ -35,26 +35,44 @@
 #endif
 #include <getopt.h>
 #include <netdb.h>
+#include <unistd.h>
 #include <netif/etharp.h>
 
 #include <rte_ethdev.h>
+#include <rte_malloc.h>
 #include <rte_mbuf.h>
 #include <rte_ring.h>
 
 #include <lwip/init.h>
 
+#include "bench.h"
 #include "bridge.h"
+#include "capture.h"
+#include "ctl.h"
 #include "dispatch.h"
 #include "ethif.h"
+#include "gen.h"
+#include "ipfrag.h"
 #include "kniif.h"
 #include "plugif.h"
+#include "ringif.h"
+#include "tapif.h"
+#ifdef ENABLE_VHOST
+#include "port-vhost.h"
+#endif
 #include "main.h"
 #include "mempool.h"
+#include "microbench.h"
+#include "pcb-hash.h"
+#include "stats.h"
+#include "trace.h"
+#include "wheel.h"
 
 /* exported in lwipopts.h */
 unsigned char debug_flags = LWIP_DBG_OFF;
 
-/* eonfigurable number of RX/TX ring descriptors
+/* default number of RX/TX ring descriptors, per port with rx_desc=
+ * and tx_desc=
  */
 #define RTE_TEST_RX_DESC_DEFAULT 128
 #define RTE_TEST_TX_DESC_DEFAULT 512
@@ -66,6 +84,35 @@ static struct net_port ports[PORT_MAX];
 static int nr_ports = 0;
 static int nr_eth_dev = 0;
 
+/* seconds between dumps of a secondary process, 0 to dump once */
+static unsigned stats_interval = 0;
+
+/* the secondary process dumps the trace rather than the statistics */
+static int trace_mode = 0;
+
+/* Unix socket of the control plane, see ctl.h */
+static char *ctl_path = NULL;
+
+/* options read from a file after the command line */
+static char *config_path = NULL;
+
+#define CONFIG_ARGS_MAX 256
+
+static struct bench_conf bench_conf = {
+	.mix = {
+		.frame_sizes = { GEN_FRAME_MIN },
+		.nr_sizes = 1,
+		.nr_flows = 1,
+	},
+	.nr_ports = BENCH_PORTS_DEFAULT,
+	.nr_peers = BENCH_PEERS_DEFAULT,
+	.secs = BENCH_SECS_DEFAULT,
+};
+
+static struct microbench_conf microbench_conf = {
+	.nr_peers = BENCH_PEERS_DEFAULT,
+};
+
 static int
 parse_address(char* addr, struct addrinfo *info, int family) {
 	struct addrinfo hints;
@@ -132,6 +179,88 @@ parse_port_pair(void *opts, char* key, char* value)
 	} else if (!strcmp(key,"gw")) {
 		PARSE_IP4(net->gw);
 		return 0;
+	} else if (!strcmp(key,"poll")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		if (!strcmp(value, "busy"))
+			net->poll_mode = NET_POLL_BUSY;
+		else if (!strcmp(value, "adaptive"))
+			net->poll_mode = NET_POLL_ADAPTIVE;
+		else
+			return -1;
+		return 0;
+	} else if (!strcmp(key,"idle_us")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->idle_us = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"weight")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->weight = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"mbufs")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->nb_mbuf = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"lowat")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->lowat_pct = rte_str_to_size(value);
+		return net->lowat_pct < 100 ? 0 : -1;
+	} else if (!strcmp(key,"cache")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->cache_size = rte_str_to_size(value);
+		return net->cache_size <= RTE_MEMPOOL_CACHE_MAX_SIZE ? 0 : -1;
+	} else if (!strcmp(key,"rx_desc")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->nb_rx_desc = rte_str_to_size(value);
+		return net->nb_rx_desc ? 0 : -1;
+	} else if (!strcmp(key,"tx_desc")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->nb_tx_desc = rte_str_to_size(value);
+		return net->nb_tx_desc ? 0 : -1;
+	} else if (!strcmp(key,"burst")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->burst = rte_str_to_size(value);
+		return net->burst && net->burst <= PKT_BURST_MAX ? 0 : -1;
+	} else if (!strcmp(key,"mtu")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		net->mtu = rte_str_to_size(value);
+		return net->mtu >= NET_MTU_MIN && net->mtu <= NET_MTU_MAX ?
+			0 : -1;
+	} else if (!strcmp(key,"members")) {
+		char *member, *save;
+
+		if (value == 0 || *value == 0)
+			return -1;
+		net->nr_members = 0;
+		for (member = strtok_r(value, ":", &save); member != NULL;
+		     member = strtok_r(NULL, ":", &save)) {
+			if (net->nr_members >= NET_MEMBERS_MAX)
+				return -1;
+			net->members[net->nr_members++] =
+				rte_str_to_size(member);
+		}
+		return net->nr_members > 0 ? 0 : -1;
+	} else if (!strcmp(key,"xmit_policy")) {
+		if (value == 0 || *value == 0)
+			return -1;
+		if (!strcmp(value, "l34"))
+			net->xmit_policy = NET_XMIT_L34;
+		else if (!strcmp(value, "l23"))
+			net->xmit_policy = NET_XMIT_L23;
+		else if (!strcmp(value, "l2"))
+			net->xmit_policy = NET_XMIT_L2;
+		else
+			return -1;
+		return 0;
 	} else {
 		return -1;
 	}
@@ -171,6 +300,150 @@ parse_vxlan_pair(void *opts, char* key, char* value)
 }
 
 static int
+parse_capture_pair(void *opts, char* key, char* value)
+{
+	struct capture_tap *tap = (struct capture_tap *)opts;
+	struct capture_filter *filter = &tap->filter;
+	struct addrinfo addr;
+	uint8_t* p;
+
+	if (key == 0 || *key == 0 || value == 0 || *value == 0)
+		return -1;
+
+	if (!strcmp(key,"port")) {
+		tap->name = value;
+		return 0;
+	} else if (!strcmp(key,"dir")) {
+		if (!strcmp(value, "rx"))
+			tap->dirs = CAPTURE_RX;
+		else if (!strcmp(value, "tx"))
+			tap->dirs = CAPTURE_TX;
+		else if (!strcmp(value, "both"))
+			tap->dirs = CAPTURE_RX | CAPTURE_TX;
+		else
+			return -1;
+		return 0;
+	} else if (!strcmp(key,"snaplen")) {
+		tap->snaplen = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"proto")) {
+		filter->ether_type = rte_cpu_to_be_16(ETHER_TYPE_IPv4);
+		if (!strcmp(value, "arp"))
+			filter->ether_type = rte_cpu_to_be_16(ETHER_TYPE_ARP);
+		else if (!strcmp(value, "icmp"))
+			filter->ip_proto = IPPROTO_ICMP;
+		else if (!strcmp(value, "udp"))
+			filter->ip_proto = IPPROTO_UDP;
+		else if (!strcmp(value, "tcp"))
+			filter->ip_proto = IPPROTO_TCP;
+		else if (strcmp(value, "ip"))
+			return -1;
+		return 0;
+	} else if (!strcmp(key,"host")) {
+		if (parse_address(value, &addr, AF_INET) != 0)
+			return -1;
+		p = (uint8_t*)&((struct sockaddr_in*)addr.ai_addr)->sin_addr;
+		IP4_ADDR(&filter->host, *p, *(p+1), *(p+2), *(p+3));
+		return 0;
+	} else if (!strcmp(key,"l4port")) {
+		filter->port = rte_cpu_to_be_16(atoi(value));
+		return 0;
+	} else if (!strcmp(key,"file")) {
+		return capture_set_path(value);
+	} else {
+		return -1;
+	}
+}
+
+static int
+parse_bench_pair(void *opts, char* key, char* value)
+{
+	struct bench_conf *conf = (struct bench_conf *)opts;
+
+	if (key == 0 || *key == 0 || value == 0 || *value == 0)
+		return -1;
+
+	if (!strcmp(key,"scenario")) {
+		return bench_parse_scenario(conf, value);
+	} else if (!strcmp(key,"size")) {
+		return gen_parse_sizes(&conf->mix, value);
+	} else if (!strcmp(key,"flows")) {
+		conf->mix.nr_flows = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"arp")) {
+		conf->mix.arp_pct = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"bcast")) {
+		conf->mix.bcast_pct = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"vxlan")) {
+		conf->mix.vxlan_pct = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"ports")) {
+		conf->nr_ports = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"peers")) {
+		conf->nr_peers = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"secs")) {
+		conf->secs = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"replay")) {
+		conf->replay_path = value;
+		return 0;
+	} else if (!strcmp(key,"speed")) {
+		conf->speed = rte_str_to_size(value);
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
+static int
+parse_microbench_pair(void *opts, char* key, char* value)
+{
+	struct microbench_conf *conf = (struct microbench_conf *)opts;
+
+	if (key == 0 || *key == 0 || value == 0 || *value == 0)
+		return -1;
+
+	if (!strcmp(key,"iters")) {
+		conf->iters = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"size")) {
+		conf->frame_size = rte_str_to_size(value);
+		return 0;
+	} else if (!strcmp(key,"peers")) {
+		conf->nr_peers = rte_str_to_size(value);
+		return 0;
+	} else {
+		return -1;
+	}
+}
+
+static int
+parse_mempool_pair(void *opts, char* key, char* value)
+{
+	struct mempool_conf *conf = (struct mempool_conf *)opts;
+
+	if (key == 0 || *key == 0 || value == 0 || *value == 0)
+		return -1;
+
+	if (!strcmp(key,"mbufs")) {
+		conf->nb_mbuf = rte_str_to_size(value);
+		return conf->nb_mbuf ? 0 : -1;
+	} else if (!strcmp(key,"size")) {
+		conf->data_room = rte_str_to_size(value);
+		return conf->data_room ? 0 : -1;
+	} else if (!strcmp(key,"cache")) {
+		conf->cache_size = rte_str_to_size(value);
+		return conf->cache_size <= RTE_MEMPOOL_CACHE_MAX_SIZE ? 0 : -1;
+	} else {
+		return -1;
+	}
+}
+
+int
 parse_pairs(void *opts, char *param, int (*parse_pair)(void *, char*, char*))
 {
 	enum {
@@ -217,37 +490,90 @@ parse_pairs(void *opts, char *param, int (*parse_pair)(void *, char*, char*))
 	return 0;
 }
 
-static int
+int
 parse_port(struct net *net, char *param)
 {
 	return parse_pairs(net, param, parse_port_pair);
 }
 
-static int
+int
 parse_vxlan(struct vxlan_peer *peer, char *param)
 {
 	return parse_pairs(peer, param, parse_vxlan_pair);
 }
 
+static int
+parse_bench(struct bench_conf *conf, char *param)
+{
+	if (parse_pairs(conf, param, parse_bench_pair))
+		return -1;
+	return conf->scenario != BENCH_NONE ? 0 : -1;
+}
+
+static int
+parse_microbench(struct microbench_conf *conf, char *param)
+{
+	if (parse_pairs(conf, param, parse_microbench_pair))
+		return -1;
+	if (conf->iters == 0)
+		conf->iters = MICROBENCH_ITERS_DEFAULT;
+	return 0;
+}
+
+static int
+parse_mempool(struct mempool_conf *conf, char *param)
+{
+	return parse_pairs(conf, param, parse_mempool_pair);
+}
+
+int
+parse_capture(struct capture_tap *tap, char *param)
+{
+	if (parse_pairs(tap, param, parse_capture_pair))
+		return -1;
+	return tap->name ? 0 : -1;
+}
+
 static int
 parse_args(int argc, char **argv)
 {
 	int ch;
 	struct net_port *port;
 	struct vxlan_peer peer;
+	struct capture_tap tap;
 
 #ifdef LWIP_DEBUG
-	while ((ch = getopt(argc, argv, "P:V:e:k:d")) != -1) {
+	while ((ch = getopt(argc, argv,
+			    "B:C:M:P:U:V:e:f:k:m:r:s:t:v:Td")) != -1) {
 #else
-	while ((ch = getopt(argc, argv, "P:V:e:k:")) != -1) {
+	while ((ch = getopt(argc, argv,
+			    "B:C:M:P:U:V:e:f:k:m:r:s:t:v:T")) != -1) {
 #endif
 	switch (ch) {
+		case 'B':
+			if (parse_bench(&bench_conf, optarg))
+				return -1;
+			break;
+		case 'C':
+			memset(&tap, 0, sizeof(tap));
+			if (parse_capture(&tap, optarg))
+				return -1;
+			if (capture_add_tap(&tap) != 0)
+				return -1;
+			break;
+		case 'M':
+			if (parse_microbench(&microbench_conf, optarg))
+				return -1;
+			break;
 		case 'P':
 			port = &BR0.plug.net_port;
 			if (parse_port(&port->net, optarg))
 				return -1;
 			port->rte_port_type = RTE_PORT_TYPE_PLUG;
 			break;
+		case 'U':
+			ctl_path = optarg;
+			break;
 		case 'V':
 			memset(&peer, 0, sizeof(peer));
 			if (parse_vxlan(&peer, optarg))
@@ -264,6 +590,9 @@ parse_args(int argc, char **argv)
 			port->rte_port_type = RTE_PORT_TYPE_ETH;
 			nr_ports++;
 			break;
+		case 'f':
+			config_path = optarg;
+			break;
 		case 'k':
 			if (nr_ports >= PORT_MAX)
 				break;
@@ -273,6 +602,45 @@ parse_args(int argc, char **argv)
 			port->rte_port_type = RTE_PORT_TYPE_KNI;
 			nr_ports++;
 			break;
+		case 'r':
+			if (nr_ports >= PORT_MAX)
+				break;
+			port = &ports[nr_ports];
+			if (parse_port(&port->net, optarg) || !port->net.name)
+				return -1;
+			port->rte_port_type = RTE_PORT_TYPE_RING;
+			nr_ports++;
+			break;
+#ifdef ENABLE_VHOST
+		case 'v':
+			if (nr_ports >= PORT_MAX)
+				break;
+			port = &ports[nr_ports];
+			if (parse_port(&port->net, optarg) || !port->net.name)
+				return -1;
+			port->rte_port_type = RTE_PORT_TYPE_VHOST;
+			nr_ports++;
+			break;
+#endif
+		case 'm':
+			if (parse_mempool(&mempool_conf, optarg))
+				return -1;
+			break;
+		case 's':
+			stats_interval = rte_str_to_size(optarg);
+			break;
+		case 't':
+			if (nr_ports >= PORT_MAX)
+				break;
+			port = &ports[nr_ports];
+			if (parse_port(&port->net, optarg) || !port->net.name)
+				return -1;
+			port->rte_port_type = RTE_PORT_TYPE_TAP;
+			nr_ports++;
+			break;
+		case 'T':
+			trace_mode = 1;
+			break;
 
 #ifdef LWIP_DEBUG
 		case 'd':
@@ -293,8 +661,81 @@ parse_args(int argc, char **argv)
 	return 0;
 }
 
+/* The config file holds the same options as the command line, any
+ * number per line, with # starting a comment. The lines are kept
+ * since ports and taps point into them.
+ */
+static int
+parse_config(const char *path)
+{
+	char *argv[CONFIG_ARGS_MAX];
+	int argc = 0;
+	char buf[1024];
+	char *line, *tok, *save;
+	FILE *f;
+	int ret;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		RTE_LOG(ERR, APP, "Cannot open %s\n", path);
+		return -1;
+	}
+
+	argv[argc++] = (char *)path;
+	while (fgets(buf, sizeof(buf), f)) {
+		if ((tok = strchr(buf, '#')) != NULL)
+			*tok = 0;
+		line = strdup(buf);
+		if (line == NULL) {
+			fclose(f);
+			return -1;
+		}
+		for (tok = strtok_r(line, " \t\r\n", &save); tok;
+		     tok = strtok_r(NULL, " \t\r\n", &save)) {
+			if (argc >= CONFIG_ARGS_MAX - 1) {
+				RTE_LOG(ERR, APP, "Too many options in %s\n",
+					path);
+				fclose(f);
+				return -1;
+			}
+			argv[argc++] = tok;
+		}
+	}
+	argv[argc] = NULL;
+	fclose(f);
+
+	/* rescan from the start, a nested -f is not followed */
+	config_path = NULL;
+	optind = 0;
+	ret = parse_args(argc, argv);
+	if (config_path) {
+		RTE_LOG(ERR, APP, "Nested config file in %s\n", path);
+		return -1;
+	}
+	return ret;
+}
+
 #define IP4_OR_NULL(ip_addr) ((ip_addr).addr == IPADDR_ANY ? 0 : &(ip_addr))
 
+/* Every eth, KNI, TAP and vhost port receives into its own pool */
+static struct rte_mempool *
+create_rx_pool(struct net *net, const char *name, int socket_id,
+	       uint32_t *rx_lowat)
+{
+	uint32_t nb_mbuf = net->nb_mbuf ? : mempool_conf.nb_mbuf;
+	uint32_t pct = net->lowat_pct ? : MEMPOOL_LOWAT_PCT_DEFAULT;
+	uint32_t cache_size = net->cache_size ? : mempool_conf.cache_size;
+	struct rte_mempool *mp;
+
+	mp = mempool_rx_create(name, nb_mbuf, cache_size, socket_id);
+	if (!mp)
+		return NULL;
+
+	/* an existing pool is reused whatever its size */
+	*rx_lowat = (uint64_t)mp->size * pct / 100;
+	return mp;
+}
+
 static int
 create_eth_port(struct net_port *net_port, int socket_id)
 {
@@ -303,39 +744,46 @@ create_eth_port(struct net_port *net_port, int socket_id)
 	struct net *net = &net_port->net;
 	struct rte_port_eth_params params = {
 		.port_id = net->port_id,
-		.nb_rx_desc = RTE_TEST_RX_DESC_DEFAULT,
-		.nb_tx_desc = RTE_TEST_TX_DESC_DEFAULT,
-		.mempool = pktmbuf_pool,
+		.nb_rx_desc = net->nb_rx_desc ? : RTE_TEST_RX_DESC_DEFAULT,
+		.nb_tx_desc = net->nb_tx_desc ? : RTE_TEST_TX_DESC_DEFAULT,
+		.mtu = net->mtu ? : NET_MTU_DEFAULT,
+		.mempool = mempool_get(socket_id),
 	};
+	char name[RTE_MEMPOOL_NAMESIZE];
+
+	if (!params.mempool) {
+		RTE_LOG(ERR, APP, "Cannot get mbuf pool\n");
+		return -1;
+	}
+
+	snprintf(name, sizeof(name), "eth%u", net->port_id);
+	params.rx_mempool = create_rx_pool(net, name, socket_id,
+					   &params.rx_lowat);
+	if (!params.rx_mempool)
+		return -1;
 
 	if (!IP4_OR_NULL(net_port->net.ip_addr)) {
 		struct rte_port_eth *eth_port;
 
 		eth_port = rte_port_eth_create(&params, socket_id, net_port);
-		if (!eth_port)
-			rte_exit(EXIT_FAILURE, "Cannot alloc kni port\n");
-
-		bridge_add_port(&BR0, net_port);
+		if (!eth_port) {
+			RTE_LOG(ERR, APP, "Cannot alloc eth port\n");
+			return -1;
+		}
 	} else {
 		struct ethif *ethif;
-		struct netif *netif;
 
 		ethif = ethif_alloc(socket_id);
-		if (ethif == NULL)
-			rte_exit(EXIT_FAILURE, "Cannot alloc eth port\n");
-
-		if (ethif_init(ethif, &params, socket_id, net_port) != ERR_OK)
-			rte_exit(EXIT_FAILURE, "Cannot init eth port\n");
+		if (ethif == NULL) {
+			RTE_LOG(ERR, APP, "Cannot alloc eth port\n");
+			return -1;
+		}
 
-		netif = &ethif->netif;
-		netif_add(netif,
-			  IP4_OR_NULL(net->ip_addr),
-			  IP4_OR_NULL(net->netmask),
-			  IP4_OR_NULL(net->gw),
-			  ethif,
-			  ethif_added_cb,
-			  ethernet_input);
-		netif_set_up(netif);
+		if (ethif_init(ethif, &params, socket_id, net_port) != ERR_OK) {
+			RTE_LOG(ERR, APP, "Cannot init eth port\n");
+			rte_free(ethif);
+			return -1;
+		}
 	}
 
 	return 0;
@@ -347,44 +795,191 @@ create_kni_port(struct net_port *net_port, int socket_id)
 	RTE_VERIFY(net_port->rte_port_type == RTE_PORT_TYPE_KNI);
 
 	struct net *net = &net_port->net;
+	uint16_t mtu = net->mtu ? : NET_MTU_DEFAULT;
 	struct rte_port_kni_params params = {
 		.name = net->name,
-		.mbuf_size = MAX_PACKET_SZ,
-		.mempool = pktmbuf_pool,
+		.mbuf_size = mempool_conf.data_room,
+		.mempool = mempool_get(socket_id),
 	};
 
+	if (!params.mempool) {
+		RTE_LOG(ERR, APP, "Cannot get mbuf pool\n");
+		return -1;
+	}
+
+	/* the KNI module only takes single segment frames */
+	if (mtu + ETHER_HDR_LEN > mempool_conf.data_room) {
+		RTE_LOG(ERR, APP, "KNI port %s needs mbufs of MTU %u, "
+			"see -m size\n", net->name, mtu);
+		return -1;
+	}
+
+	params.rx_mempool = create_rx_pool(net, net->name, socket_id,
+					   &params.rx_lowat);
+	if (!params.rx_mempool)
+		return -1;
+
 	if (!IP4_OR_NULL(net_port->net.ip_addr)) {
 		struct rte_port_kni *kni_port;
 
 		kni_port = rte_port_kni_create(&params, socket_id, net_port);
-		if (!kni_port)
-			rte_exit(EXIT_FAILURE, "Cannot alloc kni port\n");
-
-		bridge_add_port(&BR0, net_port);
+		if (!kni_port) {
+			RTE_LOG(ERR, APP, "Cannot alloc kni port\n");
+			return -1;
+		}
 	} else {
 		struct kniif *kniif;
-		struct netif *netif;
 
 		kniif = kniif_alloc(socket_id);
-		if (kniif == NULL)
-			rte_exit(EXIT_FAILURE, "Cannot alloc kni interface\n");
+		if (kniif == NULL) {
+			RTE_LOG(ERR, APP, "Cannot alloc kni interface\n");
+			return -1;
+		}
 
-		if (kniif_init(kniif, &params, socket_id, net_port) != ERR_OK)
-			rte_exit(EXIT_FAILURE, "Cannot init kni interface\n");
+		if (kniif_init(kniif, &params, socket_id, net_port) != ERR_OK) {
+			RTE_LOG(ERR, APP, "Cannot init kni interface\n");
+			rte_free(kniif);
+			return -1;
+		}
+	}
 
-		netif = &kniif->netif;
-		netif_add(netif,
-			  IP4_OR_NULL(net->ip_addr),
-			  IP4_OR_NULL(net->netmask),
-			  IP4_OR_NULL(net->gw),
-			  kniif,
-			  kniif_added_cb,
-			  ethernet_input);
-		netif_set_up(netif);
+	return 0;
+}
+
+static int
+create_ring_port(struct net_port *net_port, int socket_id)
+{
+	RTE_VERIFY(net_port->rte_port_type == RTE_PORT_TYPE_RING);
+
+	struct net *net = &net_port->net;
+	struct rte_port_ring_params params = {
+		.name = net->name,
+		.size = rte_align32pow2(net->nb_rx_desc ? :
+					RING_PORT_SIZE_DEFAULT),
+		.mempool = mempool_get(socket_id),
+	};
+
+	if (!params.mempool) {
+		RTE_LOG(ERR, APP, "Cannot get mbuf pool\n");
+		return -1;
+	}
+
+	if (!IP4_OR_NULL(net_port->net.ip_addr)) {
+		struct rte_port_ring *ring_port;
+
+		ring_port = rte_port_ring_create(&params, socket_id, net_port);
+		if (!ring_port) {
+			RTE_LOG(ERR, APP, "Cannot alloc ring port\n");
+			return -1;
+		}
+	} else {
+		struct ringif *ringif;
+
+		ringif = ringif_alloc(socket_id);
+		if (ringif == NULL) {
+			RTE_LOG(ERR, APP, "Cannot alloc ring interface\n");
+			return -1;
+		}
+
+		if (ringif_init(ringif, &params, socket_id,
+				net_port) != ERR_OK) {
+			RTE_LOG(ERR, APP, "Cannot init ring interface\n");
+			rte_free(ringif);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+create_tap_port(struct net_port *net_port, int socket_id)
+{
+	RTE_VERIFY(net_port->rte_port_type == RTE_PORT_TYPE_TAP);
+
+	struct net *net = &net_port->net;
+	struct rte_port_tap_params params = {
+		.name = net->name,
+		.mtu = net->mtu ? : NET_MTU_DEFAULT,
+		.mempool = mempool_get(socket_id),
+	};
+
+	if (!params.mempool) {
+		RTE_LOG(ERR, APP, "Cannot get mbuf pool\n");
+		return -1;
+	}
+
+	params.rx_mempool = create_rx_pool(net, net->name, socket_id,
+					   &params.rx_lowat);
+	if (!params.rx_mempool)
+		return -1;
+
+	if (!IP4_OR_NULL(net_port->net.ip_addr)) {
+		struct rte_port_tap *tap_port;
+
+		tap_port = rte_port_tap_create(&params, socket_id, net_port);
+		if (!tap_port) {
+			RTE_LOG(ERR, APP, "Cannot alloc tap port\n");
+			return -1;
+		}
+	} else {
+		struct tapif *tapif;
+
+		tapif = tapif_alloc(socket_id);
+		if (tapif == NULL) {
+			RTE_LOG(ERR, APP, "Cannot alloc tap interface\n");
+			return -1;
+		}
+
+		if (tapif_init(tapif, &params, socket_id, net_port) != ERR_OK) {
+			RTE_LOG(ERR, APP, "Cannot init tap interface\n");
+			rte_free(tapif);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+#ifdef ENABLE_VHOST
+static int
+create_vhost_port(struct net_port *net_port, int socket_id)
+{
+	RTE_VERIFY(net_port->rte_port_type == RTE_PORT_TYPE_VHOST);
+
+	struct net *net = &net_port->net;
+	struct rte_port_vhost_params params = {
+		.name = net->name,
+		.mempool = mempool_get(socket_id),
+	};
+	struct rte_port_vhost *vhost_port;
+
+	if (!params.mempool) {
+		RTE_LOG(ERR, APP, "Cannot get mbuf pool\n");
+		return -1;
+	}
+
+	/* the guest is on the bridge, the local stack is reached through it */
+	if (IP4_OR_NULL(net->ip_addr)) {
+		RTE_LOG(ERR, APP, "Vhost port %s takes no address\n",
+			net->name);
+		return -1;
+	}
+
+	params.rx_mempool = create_rx_pool(net, net->name, socket_id,
+					   &params.rx_lowat);
+	if (!params.rx_mempool)
+		return -1;
+
+	vhost_port = rte_port_vhost_create(&params, socket_id, net_port);
+	if (!vhost_port) {
+		RTE_LOG(ERR, APP, "Cannot alloc vhost port\n");
+		return -1;
 	}
 
 	return 0;
 }
+#endif
 
 static int
 create_plug_port(struct net_port *net_port, int socket_id)
@@ -430,6 +1025,7 @@ create_plug_port(struct net_port *net_port, int socket_id)
 			  plugif,
 			  plugif_added_cb,
 			  ethernet_input);
+		netif->mtu = net->mtu ? : NET_MTU_DEFAULT;
 		netif_set_up(netif);
 
 		if (bridge_add_plug(&BR0, net_port, plugif) != 0)
@@ -439,6 +1035,287 @@ create_plug_port(struct net_port *net_port, int socket_id)
 	return 0;
 }
 
+/* Bonds the members of an eth port into one device on the socket of the
+ * first, which becomes the port_id of the port
+ */
+static int
+create_bond(struct net *net)
+{
+	int i, port_id, socket_id;
+	char name[STATS_NAME_SZ];
+
+	for (i = 0; i < net->nr_members; i++) {
+		if (net->members[i] >= nr_eth_dev) {
+			RTE_LOG(ERR, APP, "No ethernet device %u\n",
+				net->members[i]);
+			return -1;
+		}
+		snprintf(name, sizeof(name), "eth%u", net->members[i]);
+		if (port_lookup(name) != NULL) {
+			RTE_LOG(ERR, APP, "Port %s is in use\n", name);
+			return -1;
+		}
+	}
+
+	socket_id = rte_eth_dev_socket_id(net->members[0]);
+	if (socket_id < 0)
+		socket_id = rte_lcore_to_socket_id(rte_get_master_lcore());
+
+	port_id = rte_port_eth_bond(net->members, net->nr_members,
+				    net->xmit_policy, socket_id);
+	if (port_id < 0)
+		return -1;
+
+	snprintf(name, sizeof(name), "eth%d", port_id);
+	if (port_lookup(name) != NULL) {
+		RTE_LOG(ERR, APP, "Port %s already exists\n", name);
+		return -1;
+	}
+
+	net->port_id = port_id;
+	nr_eth_dev = rte_eth_dev_count();
+	return 0;
+}
+
+/*
+ * Sets up the device, the pools and the rte_port of an eth, KNI, ring, TAP
+ * or vhost port, at startup or on the control lcore. Nothing a dispatch
+ * round reaches is touched until port_attach().
+ */
+int
+port_setup(struct net_port *net_port)
+{
+	/* the socket of the dispatch lcore, not of the control lcore */
+	int dispatch_socket = rte_lcore_to_socket_id(rte_get_master_lcore());
+	int socket_id;
+
+	switch (net_port->rte_port_type) {
+	case RTE_PORT_TYPE_ETH:
+		if (net_port->net.nr_members > 0 &&
+		    create_bond(&net_port->net) != 0)
+			return -1;
+
+		if (net_port->net.port_id >= nr_eth_dev) {
+			RTE_LOG(ERR, APP, "No ethernet device %u\n",
+				net_port->net.port_id);
+			return -1;
+		}
+		if (rte_port_eth_bonded(net_port->net.port_id)) {
+			RTE_LOG(ERR, APP, "Ethernet device %u is bonded\n",
+				net_port->net.port_id);
+			return -1;
+		}
+
+		/* queues, pool and port state on the NIC's socket */
+		socket_id = rte_eth_dev_socket_id(net_port->net.port_id);
+		if (socket_id < 0)
+			socket_id = dispatch_socket;
+		if (socket_id != dispatch_socket)
+			RTE_LOG(WARNING, APP,
+				"Port %u is on socket %d, dispatched "
+				"from socket %d\n",
+				net_port->net.port_id, socket_id,
+				dispatch_socket);
+
+		if (create_eth_port(net_port, socket_id) != 0)
+			return -1;
+
+		RTE_LOG(INFO, APP, "Created eth port port_id=%u\n",
+			net_port->net.port_id);
+		break;
+	case RTE_PORT_TYPE_KNI:
+		if (create_kni_port(net_port, dispatch_socket) != 0)
+			return -1;
+
+		RTE_LOG(INFO, APP, "Created kni port name=%s\n",
+			net_port->net.name);
+		break;
+	case RTE_PORT_TYPE_RING:
+		if (create_ring_port(net_port, dispatch_socket) != 0)
+			return -1;
+
+		RTE_LOG(INFO, APP, "Created ring port name=%s\n",
+			net_port->net.name);
+		break;
+	case RTE_PORT_TYPE_TAP:
+		if (create_tap_port(net_port, dispatch_socket) != 0)
+			return -1;
+
+		RTE_LOG(INFO, APP, "Created tap port name=%s\n",
+			net_port->net.name);
+		break;
+#ifdef ENABLE_VHOST
+	case RTE_PORT_TYPE_VHOST:
+		if (create_vhost_port(net_port, dispatch_socket) != 0)
+			return -1;
+
+		RTE_LOG(INFO, APP, "Created vhost port name=%s\n",
+			net_port->net.name);
+		break;
+#endif
+	default:
+		RTE_LOG(ERR, APP, "Invalid port type\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The lwIP interface of a port set up with an address, whose state is set
+ * by the init of the interface so that a port failing to attach can still
+ * be released
+ */
+static int
+attach_netif(struct net_port *net_port)
+{
+	struct net *net = &net_port->net;
+	struct netif *netif = net_port->netif;
+	netif_init_fn init;
+
+	switch (net_port->rte_port_type) {
+	case RTE_PORT_TYPE_ETH:
+		init = ethif_added_cb;
+		break;
+	case RTE_PORT_TYPE_KNI:
+		init = kniif_added_cb;
+		break;
+	case RTE_PORT_TYPE_RING:
+		init = ringif_added_cb;
+		break;
+	case RTE_PORT_TYPE_TAP:
+		init = tapif_added_cb;
+		break;
+	default:
+		return -1;
+	}
+
+	if (netif_add(netif,
+		      IP4_OR_NULL(net->ip_addr),
+		      IP4_OR_NULL(net->netmask),
+		      IP4_OR_NULL(net->gw),
+		      netif->state,
+		      init,
+		      ethernet_input) == NULL) {
+		RTE_LOG(ERR, APP, "Cannot add interface\n");
+		return -1;
+	}
+	netif->mtu = net->mtu ? : NET_MTU_DEFAULT;
+	netif_set_up(netif);
+	return 0;
+}
+
+/*
+ * Puts a port set up by port_setup() on the bridge or the lwIP stack and
+ * adds it to the dispatch loop, on the dispatch lcore.
+ */
+int
+port_attach(struct net_port *net_port)
+{
+	struct rte_port_kni *kni_port = NULL;
+
+#ifdef ENABLE_VHOST
+	if (net_port->rte_port_type == RTE_PORT_TYPE_VHOST &&
+	    rte_port_vhost_start() != 0)
+		return -1;
+#endif
+
+	if (net_port->netif) {
+		if (attach_netif(net_port) != 0)
+			return -1;
+	} else if (bridge_add_port(&BR0, net_port) != 0) {
+		RTE_LOG(ERR, APP, "Cannot add bridge port\n");
+		return -1;
+	}
+
+	if (net_port->rte_port_type == RTE_PORT_TYPE_KNI) {
+		kni_port = container_of(net_port->rte_port,
+					struct rte_port_kni, rte_port);
+		rte_port_kni_start(kni_port);
+	}
+
+	if (dispatch_add_port(net_port) != 0) {
+		if (kni_port)
+			rte_port_kni_stop(kni_port);
+		if (net_port->netif)
+			netif_remove(net_port->netif);
+		else
+			bridge_del_port(&BR0, net_port);
+		return -1;
+	}
+	return 0;
+}
+
+/* At startup, on the dispatch lcore */
+int
+port_create(struct net_port *net_port)
+{
+	if (port_setup(net_port) != 0)
+		return -1;
+	return port_attach(net_port);
+}
+
+/* A free entry of the port table, or NULL */
+struct net_port *
+port_alloc(void)
+{
+	int i;
+
+	for (i = 0; i < PORT_MAX; i++) {
+		if (ports[i].rte_port_type == 0) {
+			memset(&ports[i], 0, sizeof(ports[i]));
+			if (i >= nr_ports)
+				nr_ports = i + 1;
+			return &ports[i];
+		}
+	}
+	return NULL;
+}
+
+/* Looks a port up by its statistics name, i.e. eth<port_id> or the KNI,
+ * ring, TAP or vhost name
+ */
+struct net_port *
+port_lookup(const char *name)
+{
+	struct rte_port *rte_port = stats_port_lookup(name);
+	int i;
+
+	if (rte_port == NULL)
+		return NULL;
+
+	for (i = 0; i < nr_ports; i++) {
+		if (ports[i].rte_port_type && ports[i].rte_port == rte_port)
+			return &ports[i];
+	}
+	return NULL;
+}
+
+/*
+ * A secondary process only reads the statistics or the trace of the
+ * primary process, without touching its data plane.
+ */
+static int
+stats_monitor(void)
+{
+	if (trace_mode) {
+		if (trace_attach() != 0)
+			rte_exit(EXIT_FAILURE, "Cannot attach trace\n");
+		trace_dump(stdout);
+		return 0;
+	}
+
+	if (stats_attach() != 0)
+		rte_exit(EXIT_FAILURE, "Cannot attach stats\n");
+
+	for (;;) {
+		stats_dump(stdout);
+		if (stats_interval == 0)
+			break;
+		sleep(stats_interval);
+	}
+	return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -456,37 +1333,53 @@ main(int argc, char *argv[])
         if (ret < 0)
 		rte_exit(EXIT_FAILURE, "Invalid arguments\n");
 
+	if (config_path && parse_config(config_path) < 0)
+		rte_exit(EXIT_FAILURE, "Invalid config file\n");
+
+	if (rte_eal_process_type() == RTE_PROC_SECONDARY)
+		return stats_monitor();
+
 	if (rte_eal_pci_probe() < 0)
                 rte_exit(EXIT_FAILURE, "Cannot probe PCI\n");
 
+	if (bench_conf.scenario != BENCH_NONE) {
+		ret = bench_setup(&bench_conf, &ports[nr_ports],
+				  PORT_MAX - nr_ports);
+		if (ret < 0)
+			rte_exit(EXIT_FAILURE, "Cannot set up benchmark\n");
+		nr_ports += ret;
+	}
+
         nr_eth_dev = rte_eth_dev_count();
 
 	RTE_LOG(INFO, APP, "Found %d ethernet device\n", nr_eth_dev);
 
 	mempool_init(rte_socket_id());
 
-	for (i = 0; i < nr_ports; i++) {
-		struct net_port *net_port = &ports[i];
+	if (stats_init(rte_socket_id()) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init stats\n");
 
-		switch (net_port->rte_port_type) {
-		case RTE_PORT_TYPE_ETH:
-			if (net_port->net.port_id >= nr_eth_dev)
-				rte_exit(EXIT_FAILURE, "No ethernet device\n");
+	if (trace_init(rte_socket_id()) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init trace\n");
 
-			create_eth_port(net_port, rte_socket_id());
+	if (wheel_init() != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init timer wheel\n");
 
-			RTE_LOG(INFO, APP, "Created eth port port_id=%u\n",
-				net_port->net.port_id);
-			break;
-		case RTE_PORT_TYPE_KNI:
-			create_kni_port(net_port, rte_socket_id());
+	if (ipfrag_init() != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init IP fragmentation\n");
 
-			RTE_LOG(INFO, APP, "Created kni port name=%s\n",
-				net_port->net.name);
-			break;
-		default:
-			rte_exit(EXIT_FAILURE, "Invalid port type\n");
-		}
+	if (pcb_hash_init(rte_socket_id()) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot init pcb hash\n");
+
+	if (microbench_conf.iters) {
+		if (microbench_run(&microbench_conf, stdout) != 0)
+			rte_exit(EXIT_FAILURE, "Cannot run microbenchmarks\n");
+		return 0;
+	}
+
+	for (i = 0; i < nr_ports; i++) {
+		if (port_create(&ports[i]) != 0)
+			rte_exit(EXIT_FAILURE, "Cannot create port\n");
 	}
 
 	if (BR0.plug.net_port.rte_port_type) {
@@ -494,7 +1387,7 @@ main(int argc, char *argv[])
 
 		RTE_LOG(INFO, APP, "Created plug port in bridge\n");
 
-		if (BR0.vxlan.nr_peers > 0){
+		if (bridge_nr_peers(&BR0) > 0){
 			if (bridge_bind_vxlan(&BR0) != ERR_OK)
 				rte_exit(EXIT_FAILURE, "Cannot bind VXLAN\n");
 
@@ -502,7 +1395,21 @@ main(int argc, char *argv[])
 		}
 	}
 
+	if (capture_start() != 0)
+		rte_exit(EXIT_FAILURE, "Cannot start capture\n");
+
+	if (bench_conf.scenario != BENCH_NONE && bench_start() != 0)
+		rte_exit(EXIT_FAILURE, "Cannot start benchmark\n");
+
+	if (ctl_path && ctl_start(ctl_path) != 0)
+		rte_exit(EXIT_FAILURE, "Cannot start control socket\n");
+
 	RTE_LOG(INFO, APP, "Dispatching %d ports\n", nr_ports);
 
-	return dispatch_thread(ports, nr_ports, PKT_BURST_SZ);
+	ret = dispatch_thread(PKT_BURST_MAX);
+
+	if (bench_conf.scenario != BENCH_NONE)
+		bench_report(stdout);
+
+	return ret;
 }
@@ -33,25 +33,59 @@
 #ifndef _MAIN_H_
 #define _MAIN_H_
 
+#include <rte_launch.h>
+#include <rte_lcore.h>
+
 /* Macros for printing using RTE_LOG */
 #define RTE_LOGTYPE_APP RTE_LOGTYPE_USER1
 
-/* Max size of a single packet */
+/* Max size of a single packet, by default, see mempool.h */
 #define MAX_PACKET_SZ           2048
 
-/* Number of bytes needed for each mbuf */
-#define MBUF_SZ \
-        (MAX_PACKET_SZ + sizeof(struct rte_mbuf) + RTE_PKTMBUF_HEADROOM)
-
-/* Number of mbufs in mempool that is created */
+/* Number of mbufs in each mempool that is created, by default */
 #define NB_MBUF                 8192
 
-/* How many packets to attempt to read from NIC in one go */
+/* How many packets to attempt to read from NIC in one go, by default */
 #define PKT_BURST_SZ            32
+#define PKT_BURST_MAX           256
 
-/* How many objects (mbufs) to keep in per-lcore mempool cache */
+/* How many objects (mbufs) to keep in per-lcore mempool cache, by default */
 #define MEMPOOL_CACHE_SZ        PKT_BURST_SZ
 
 extern struct rte_mempool *mempool;
 
+struct capture_tap;
+struct net;
+struct net_port;
+struct vxlan_peer;
+
+/* shared with the control socket, see ctl.h */
+int parse_pairs(void *opts, char *param,
+		int (*parse_pair)(void *, char*, char*));
+int parse_port(struct net *net, char *param);
+int parse_vxlan(struct vxlan_peer *peer, char *param);
+int parse_capture(struct capture_tap *tap, char *param);
+int port_setup(struct net_port *net_port);
+int port_attach(struct net_port *net_port);
+int port_create(struct net_port *net_port);
+struct net_port * port_alloc(void);
+struct net_port * port_lookup(const char *name);
+
+/* First slave lcore not running anything yet, the master's socket first */
+static inline unsigned
+spare_lcore(void)
+{
+	unsigned lcore_id, any = RTE_MAX_LCORE;
+
+	RTE_LCORE_FOREACH_SLAVE(lcore_id) {
+		if (rte_eal_get_lcore_state(lcore_id) != WAIT)
+			continue;
+		if (rte_lcore_to_socket_id(lcore_id) == rte_socket_id())
+			return lcore_id;
+		if (any == RTE_MAX_LCORE)
+			any = lcore_id;
+	}
+	return any;
+}
+
 #endif
@@ -34,21 +34,232 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_memcpy.h>
+
+#include "latency.h"
 #include "main.h"
 #include "mempool.h"
+#include "stats.h"
+
+struct mempool_conf mempool_conf = {
+	.nb_mbuf = NB_MBUF,
+	.data_room = MAX_PACKET_SZ,
+	.cache_size = MEMPOOL_CACHE_SZ,
+};
 
 struct rte_mempool *pktmbuf_pool;
+struct rte_mempool *indirect_pool;
 
-int
-mempool_init(int socket_id)
+static struct rte_mempool *pktmbuf_pools[RTE_MAX_NUMA_NODES];
+static struct rte_mempool *indirect_pools[RTE_MAX_NUMA_NODES];
+
+static int
+mempool_create(int socket_id)
 {
-	pktmbuf_pool = rte_mempool_create(
-		"pktmbuf_pool", NB_MBUF, MBUF_SZ, MEMPOOL_CACHE_SZ,
+	char name[RTE_MEMPOOL_NAMESIZE];
+
+	snprintf(name, sizeof(name), "pktmbuf_pool_%d", socket_id);
+	pktmbuf_pools[socket_id] = rte_mempool_create(
+		name, mempool_conf.nb_mbuf,
+		MEMPOOL_MBUF_SZ(mempool_conf.data_room),
+		mempool_conf.cache_size,
 		sizeof(struct rte_pktmbuf_pool_private),
 		rte_pktmbuf_pool_init, NULL, rte_pktmbuf_init, NULL,
 		socket_id, 0);
-	if (!pktmbuf_pool)
-		rte_panic("Cannot init mbuf pool\n");
+	if (!pktmbuf_pools[socket_id]) {
+		RTE_LOG(ERR, APP, "Cannot init mbuf pool on socket %d\n",
+			socket_id);
+		return -1;
+	}
+
+	/* indirect mbufs only reference the data of other mbufs */
+	snprintf(name, sizeof(name), "indirect_pool_%d", socket_id);
+	indirect_pools[socket_id] = rte_mempool_create(
+		name, mempool_conf.nb_mbuf, sizeof(struct rte_mbuf),
+		mempool_conf.cache_size, 0,
+		NULL, NULL, rte_pktmbuf_init, NULL,
+		socket_id, 0);
+	if (!indirect_pools[socket_id]) {
+		RTE_LOG(ERR, APP, "Cannot init indirect mbuf pool on "
+			"socket %d\n", socket_id);
+		return -1;
+	}
 
 	return 0;
 }
+
+/* devices of unknown socket, as virtual ones, use the master's */
+static int
+mempool_socket(int socket_id)
+{
+	if (socket_id < 0 || socket_id >= RTE_MAX_NUMA_NODES)
+		return rte_socket_id();
+	return socket_id;
+}
+
+int
+mempool_init(int socket_id)
+{
+	socket_id = mempool_socket(socket_id);
+
+	if (mempool_create(socket_id) != 0)
+		rte_panic("Cannot init mbuf pools\n");
+
+	pktmbuf_pool = pktmbuf_pools[socket_id];
+	indirect_pool = indirect_pools[socket_id];
+
+	return 0;
+}
+
+/* The pools of other sockets are created on first use, by their ports */
+struct rte_mempool *
+mempool_get(int socket_id)
+{
+	socket_id = mempool_socket(socket_id);
+
+	if (!pktmbuf_pools[socket_id] && mempool_create(socket_id) != 0)
+		return NULL;
+
+	return pktmbuf_pools[socket_id];
+}
+
+struct rte_mempool *
+mempool_indirect_get(int socket_id)
+{
+	socket_id = mempool_socket(socket_id);
+
+	if (!indirect_pools[socket_id] && mempool_create(socket_id) != 0)
+		return NULL;
+
+	return indirect_pools[socket_id];
+}
+
+struct rte_mempool *
+mempool_rx_create(const char *name, uint32_t nb_mbuf, uint32_t cache_size,
+		  int socket_id)
+{
+	char pool_name[RTE_MEMPOOL_NAMESIZE];
+	struct rte_mempool *mp;
+
+	snprintf(pool_name, sizeof(pool_name), "rx_pool_%s", name);
+
+	/* pools are never freed, a port added again gets its old one */
+	mp = rte_mempool_lookup(pool_name);
+	if (mp)
+		return mp;
+
+	mp = rte_mempool_create(
+		pool_name, nb_mbuf,
+		MEMPOOL_MBUF_SZ(mempool_conf.data_room), cache_size,
+		sizeof(struct rte_pktmbuf_pool_private),
+		rte_pktmbuf_pool_init, NULL, rte_pktmbuf_init, NULL,
+		mempool_socket(socket_id), 0);
+	if (!mp)
+		RTE_LOG(ERR, APP, "Cannot init RX pool of %s\n", name);
+
+	return mp;
+}
+
+/* buffer ownership and responsivity [rx_shed]
+ *   mbuf: return the ARP frames to the caller, free all others here
+ */
+uint32_t
+mempool_rx_shed(struct rte_port *rte_port,
+		struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct ether_hdr *eth;
+	uint32_t i, n = 0;
+
+	for (i = 0; i < n_pkts; i++) {
+		eth = rte_pktmbuf_mtod(pkts[i], struct ether_hdr *);
+		if (eth->ether_type == rte_cpu_to_be_16(ETHER_TYPE_ARP)) {
+			pkts[n++] = pkts[i];
+			continue;
+		}
+		rte_pktmbuf_free(pkts[i]);
+	}
+
+	rte_port_drop(rte_port, DROP_RX_LOWAT, n_pkts - n);
+
+	return n;
+}
+
+/* buffer ownership and responsivity [clone]
+ *   mbuf: m is left to the caller, the clone shares its data
+ *
+ * rte_pktmbuf_clone() of DPDK 1.7 attaches to each segment as if it
+ * were direct, so a segment that is already a clone ends up counting a
+ * reference it does not hold. Each segment is attached to the direct
+ * mbuf behind it instead, with the data and metadata of the segment.
+ */
+struct rte_mbuf *
+mempool_clone(struct rte_mbuf *m, struct rte_mempool *mp)
+{
+	struct rte_mbuf *head = NULL, **next = &head;
+	struct rte_mbuf *mi, *md, *seg;
+
+	for (seg = m; seg != NULL; seg = seg->pkt.next) {
+		mi = rte_pktmbuf_alloc(mp);
+		if (mi == NULL) {
+			if (head)
+				rte_pktmbuf_free(head);
+			return NULL;
+		}
+
+		md = RTE_MBUF_INDIRECT(seg) ?
+			RTE_MBUF_FROM_BADDR(seg->buf_addr) : seg;
+		rte_pktmbuf_attach(mi, md);
+		mi->pkt = seg->pkt;
+		mi->pkt.next = NULL;
+		mi->ol_flags = seg->ol_flags;
+
+		*next = mi;
+		next = &mi->pkt.next;
+	}
+	return head;
+}
+
+/* buffer ownership and responsivity [copy]
+ *   mbuf: m is left to the caller, the copy is made of direct mbufs
+ *         of mp, filled up one after the other
+ */
+struct rte_mbuf *
+mempool_copy(struct rte_mbuf *m, struct rte_mempool *mp)
+{
+	struct rte_mbuf *head, *d, *seg;
+	uint32_t off, n;
+
+	head = d = rte_pktmbuf_alloc(mp);
+	if (head == NULL)
+		return NULL;
+
+	for (seg = m; seg != NULL; seg = seg->pkt.next) {
+		for (off = 0; off < seg->pkt.data_len; off += n) {
+			if (rte_pktmbuf_tailroom(d) == 0) {
+				d->pkt.next = rte_pktmbuf_alloc(mp);
+				if (d->pkt.next == NULL) {
+					rte_pktmbuf_free(head);
+					return NULL;
+				}
+				d = d->pkt.next;
+				head->pkt.nb_segs++;
+			}
+			n = RTE_MIN((uint32_t)rte_pktmbuf_tailroom(d),
+				    seg->pkt.data_len - off);
+			rte_memcpy(rte_pktmbuf_mtod(d, char *) +
+				   d->pkt.data_len,
+				   rte_pktmbuf_mtod(seg, char *) + off, n);
+			d->pkt.data_len += n;
+		}
+	}
+
+	head->pkt.pkt_len = m->pkt.pkt_len;
+	head->pkt.vlan_macip = m->pkt.vlan_macip;
+	head->ol_flags = m->ol_flags;
+	mbuf_tsc_set(head, mbuf_tsc(m));
+	return head;
+}
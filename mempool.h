@@ -35,9 +35,64 @@
 
 #include <rte_mbuf.h>
 #include <rte_mempool.h>
+#include <rte_ring.h>
 
+#include "port.h"
+
+/* Number of bytes needed for each mbuf of data_room bytes */
+#define MEMPOOL_MBUF_SZ(data_room) \
+	((data_room) + sizeof(struct rte_mbuf) + RTE_PKTMBUF_HEADROOM)
+
+/* Applies to the pools of every socket */
+struct mempool_conf {
+	uint32_t	 nb_mbuf;
+	uint16_t	 data_room;
+	uint32_t	 cache_size;
+};
+
+extern struct mempool_conf mempool_conf;
+
+/*
+ * A port with its own RX pool drops all but ARP at RX once fewer than
+ * this percent of the pool is free, so that a flooded port runs out of
+ * its own mbufs before the others or lwIP run out of theirs.
+ */
+#define MEMPOOL_LOWAT_PCT_DEFAULT	10
+
+/* pools of the master's socket */
 extern struct rte_mempool *pktmbuf_pool;
+extern struct rte_mempool *indirect_pool;
 
 int mempool_init(int socket_id);
+struct rte_mempool * mempool_get(int socket_id);
+struct rte_mempool * mempool_indirect_get(int socket_id);
+struct rte_mempool * mempool_rx_create(const char *name, uint32_t nb_mbuf,
+				       uint32_t cache_size, int socket_id);
+uint32_t mempool_rx_shed(struct rte_port *rte_port,
+			 struct rte_mbuf **pkts, uint32_t n_pkts);
+struct rte_mbuf * mempool_clone(struct rte_mbuf *m, struct rte_mempool *mp);
+struct rte_mbuf * mempool_copy(struct rte_mbuf *m, struct rte_mempool *mp);
+
+/* whether a segment of m is a clone */
+static inline int
+mempool_has_indirect(struct rte_mbuf *m)
+{
+	for (; m != NULL; m = m->pkt.next) {
+		if (RTE_MBUF_INDIRECT(m))
+			return 1;
+	}
+	return 0;
+}
+
+/* on every RX burst: rte_mempool_count() would also walk the cache of
+ * every lcore, the common ring alone errs on the side of shedding early
+ */
+static inline int
+mempool_rx_low(struct rte_port *rte_port)
+{
+	return rte_port->rx_mempool &&
+		rte_ring_count(rte_port->rx_mempool->ring) <
+		rte_port->rx_lowat;
+}
 
 #endif
@@ -0,0 +1,344 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_memcpy.h>
+
+#include <lwip/pbuf.h>
+
+#include "bridge.h"
+#include "convert.h"
+#include "main.h"
+#include "mempool.h"
+#include "microbench.h"
+
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION		"unknown"
+#endif
+
+#define MICROBENCH_WARMUP	1000
+
+/* Ethernet, IP and UDP headers lwIP puts in their own pbuf */
+#define MICROBENCH_HDR_LEN	42
+
+typedef enum {
+	MICROBENCH_RX = 0,	/* mbuf_to_pbuf */
+	MICROBENCH_TX,		/* pbuf_to_mbuf */
+	MICROBENCH_ENCAP,	/* vxlan_encap and a clone per extra peer */
+	MICROBENCH_DECAP,	/* vxlan_decap */
+} microbench_kind;
+
+struct microbench_case {
+	const char	*path;
+	const char	*shape;
+	microbench_kind	 kind;
+	int		 arg;	/* segment length, 0 for a whole mbuf,
+				 * or pbuf type */
+};
+
+static const struct microbench_case microbench_cases[] = {
+	{ "mbuf_to_pbuf", "linear", MICROBENCH_RX, 0 },
+	{ "mbuf_to_pbuf", "seg256", MICROBENCH_RX, 256 },
+	{ "pbuf_to_mbuf", "ram", MICROBENCH_TX, PBUF_RAM },
+	{ "pbuf_to_mbuf", "pool", MICROBENCH_TX, PBUF_POOL },
+	{ "pbuf_to_mbuf", "hdr_ref", MICROBENCH_TX, PBUF_REF },
+	{ "vxlan_encap", "linear", MICROBENCH_ENCAP, 0 },
+	{ "vxlan_decap", "linear", MICROBENCH_DECAP, 0 },
+};
+
+static const uint16_t microbench_sizes[] = {
+	64, 128, 256, 512, 1024, 1518, 2048, 4096, MICROBENCH_SIZE_MAX,
+};
+
+static uint8_t microbench_data[MICROBENCH_SIZE_MAX];
+
+/* A frame of size bytes split into segments of at most seg_len bytes */
+static struct rte_mbuf *
+microbench_mbuf(uint16_t size, uint16_t seg_len)
+{
+	struct rte_mbuf *m = NULL, *last = NULL, *seg;
+	uint16_t off, n;
+
+	if (seg_len == 0)
+		seg_len = mempool_conf.data_room;
+
+	for (off = 0; off < size; off += n) {
+		n = RTE_MIN(seg_len, size - off);
+		seg = rte_pktmbuf_alloc(pktmbuf_pool);
+		if (seg == NULL) {
+			if (m)
+				rte_pktmbuf_free(m);
+			return NULL;
+		}
+		rte_memcpy(rte_pktmbuf_append(seg, n),
+			   microbench_data + off, n);
+
+		if (m == NULL) {
+			m = seg;
+		} else {
+			last->pkt.next = seg;
+			m->pkt.nb_segs++;
+			m->pkt.pkt_len += n;
+		}
+		last = seg;
+	}
+	return m;
+}
+
+/*
+ * A frame of size bytes in a single PBUF_RAM, a chain of PBUF_POOL, or
+ * a PBUF_RAM header followed by a PBUF_REF payload as udp_send() does.
+ */
+static struct pbuf *
+microbench_pbuf(uint16_t size, pbuf_type type)
+{
+	struct pbuf *p, *q;
+
+	if (type != PBUF_REF) {
+		p = pbuf_alloc(PBUF_RAW, size, type);
+		if (p == NULL)
+			return NULL;
+		pbuf_take(p, microbench_data, size);
+		return p;
+	}
+
+	if (size <= MICROBENCH_HDR_LEN)
+		return NULL;
+
+	p = pbuf_alloc(PBUF_RAW, MICROBENCH_HDR_LEN, PBUF_RAM);
+	if (p == NULL)
+		return NULL;
+	q = pbuf_alloc(PBUF_RAW, size - MICROBENCH_HDR_LEN, PBUF_REF);
+	if (q == NULL) {
+		pbuf_free(p);
+		return NULL;
+	}
+	pbuf_take(p, microbench_data, MICROBENCH_HDR_LEN);
+	q->payload = microbench_data + MICROBENCH_HDR_LEN;
+	pbuf_cat(p, q);
+	return p;
+}
+
+/*
+ * Each case runs MICROBENCH_WARMUP untimed iterations first, then iters
+ * timed ones, and returns the cycles they took or 0 on failure. The
+ * input is built once; the output is freed within the timed loop, as
+ * the data path does.
+ */
+static uint64_t
+microbench_rx(struct rte_mbuf *m, uint32_t iters)
+{
+	struct pbuf *p;
+	uint64_t start = 0;
+	uint32_t i, n, round;
+
+	for (round = 0; round < 2; round++) {
+		n = round ? iters : MICROBENCH_WARMUP;
+		start = rte_rdtsc();
+		for (i = 0; i < n; i++) {
+			p = mbuf_to_pbuf(m);
+			if (unlikely(p == NULL))
+				return 0;
+			pbuf_free(p);
+		}
+	}
+	return rte_rdtsc() - start;
+}
+
+static uint64_t
+microbench_tx(struct pbuf *p, uint32_t iters)
+{
+	struct rte_mbuf *m;
+	uint64_t start = 0;
+	uint32_t i, n, round;
+
+	for (round = 0; round < 2; round++) {
+		n = round ? iters : MICROBENCH_WARMUP;
+		start = rte_rdtsc();
+		for (i = 0; i < n; i++) {
+			m = pbuf_to_mbuf(p, pktmbuf_pool);
+			if (unlikely(m == NULL))
+				return 0;
+			rte_pktmbuf_free(m);
+		}
+	}
+	return rte_rdtsc() - start;
+}
+
+/* the header is pulled back after each iteration to reuse the frame */
+static uint64_t
+microbench_encap(struct rte_mbuf *m, uint32_t nr_peers, uint32_t iters)
+{
+	struct rte_mbuf *clones[VXLAN_DST_MAX];
+	uint64_t start = 0;
+	uint32_t i, j, n, round;
+
+	nr_peers = RTE_MAX(1, RTE_MIN(nr_peers, VXLAN_DST_MAX));
+
+	for (round = 0; round < 2; round++) {
+		n = round ? iters : MICROBENCH_WARMUP;
+		start = rte_rdtsc();
+		for (i = 0; i < n; i++) {
+			if (unlikely(vxlan_encap(m) != 0))
+				return 0;
+			for (j = 1; j < nr_peers; j++) {
+				clones[j] = mempool_clone(m, indirect_pool);
+				if (unlikely(clones[j] == NULL))
+					return 0;
+			}
+			for (j = 1; j < nr_peers; j++)
+				rte_pktmbuf_free(clones[j]);
+			rte_pktmbuf_adj(m, sizeof(struct vxlanhdr));
+		}
+	}
+	return rte_rdtsc() - start;
+}
+
+/* the outer headers are pushed back after each iteration */
+static uint64_t
+microbench_decap(struct rte_mbuf *m, uint32_t iters)
+{
+	uint16_t len = udp_mbuf_payload_offset(m) + sizeof(struct vxlanhdr);
+	uint64_t start = 0;
+	uint32_t i, n, round;
+
+	for (round = 0; round < 2; round++) {
+		n = round ? iters : MICROBENCH_WARMUP;
+		start = rte_rdtsc();
+		for (i = 0; i < n; i++) {
+			if (unlikely(vxlan_decap(m) != 0))
+				return 0;
+			rte_pktmbuf_prepend(m, len);
+		}
+	}
+	return rte_rdtsc() - start;
+}
+
+static uint64_t
+microbench_case(const struct microbench_case *c, uint16_t size,
+		struct microbench_conf *conf)
+{
+	struct rte_mbuf *m;
+	struct pbuf *p;
+	uint64_t cycles = 0;
+
+	if (c->kind == MICROBENCH_TX) {
+		p = microbench_pbuf(size, (pbuf_type)c->arg);
+		if (p == NULL)
+			return 0;
+		cycles = microbench_tx(p, conf->iters);
+		pbuf_free(p);
+		return cycles;
+	}
+
+	m = microbench_mbuf(size, c->arg);
+	if (m == NULL)
+		return 0;
+
+	switch (c->kind) {
+	case MICROBENCH_RX:
+		cycles = microbench_rx(m, conf->iters);
+		break;
+	case MICROBENCH_ENCAP:
+		cycles = microbench_encap(m, conf->nr_peers, conf->iters);
+		break;
+	case MICROBENCH_DECAP:
+		/* as udp-mbuf leaves it to vxlan_recv */
+		m->pkt.vlan_macip.f.l2_len = sizeof(struct ether_hdr);
+		m->pkt.vlan_macip.f.l3_len = sizeof(struct ipv4_hdr);
+		cycles = microbench_decap(m, conf->iters);
+		break;
+	default:
+		break;
+	}
+
+	rte_pktmbuf_free(m);
+	return cycles;
+}
+
+/*
+ * Runs every conversion and VXLAN case over the frame sizes of the suite,
+ * or only conf->frame_size, without any port. One JSON object per case.
+ */
+int
+microbench_run(struct microbench_conf *conf, FILE *f)
+{
+	const struct microbench_case *c;
+	uint64_t cycles, hz = rte_get_tsc_hz();
+	uint16_t size;
+	uint32_t i, j;
+
+	if (conf->frame_size > MICROBENCH_SIZE_MAX)
+		return -1;
+
+	for (i = 0; i < sizeof(microbench_data); i++)
+		microbench_data[i] = i;
+
+	for (i = 0; i < RTE_DIM(microbench_cases); i++) {
+		c = &microbench_cases[i];
+
+		for (j = 0; j < RTE_DIM(microbench_sizes); j++) {
+			size = conf->frame_size ? conf->frame_size :
+				microbench_sizes[j];
+
+			cycles = microbench_case(c, size, conf);
+			if (cycles == 0) {
+				RTE_LOG(INFO, APP, "Skipped %s/%s at %u bytes\n",
+					c->path, c->shape, size);
+			} else {
+				fprintf(f, "{\"version\":\"%s\",\"path\":\"%s\","
+					"\"shape\":\"%s\",\"frame_size\":%u,"
+					"\"iters\":%u,\"ns_per_pkt\":%.1f,"
+					"\"cycles_per_pkt\":%.1f,"
+					"\"bytes_per_cycle\":%.3f}\n",
+					PACKAGE_VERSION, c->path, c->shape,
+					size, conf->iters,
+					(double)cycles * 1e9 / hz / conf->iters,
+					(double)cycles / conf->iters,
+					(double)size * conf->iters / cycles);
+				fflush(f);
+			}
+
+			if (conf->frame_size)
+				break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rte_hash.h>
+#include <rte_jhash.h>
+#include <rte_log.h>
+
+#include "main.h"
+#include "pcb-hash.h"
+
+struct pcb_hash_key {
+	u32_t	local_ip;
+	u32_t	remote_ip;
+	u16_t	local_port;
+	u16_t	remote_port;
+	u8_t	proto;
+	u8_t	pad[3];
+};
+
+enum {
+	PCB_HASH_EXACT = 0,
+	PCB_HASH_EXACT_ANY,
+	PCB_HASH_LISTEN,
+	PCB_HASH_LISTEN_ANY,
+	PCB_HASH_NR_SHAPES,
+};
+
+static struct rte_hash *pcb_hash;
+static void *pcbs[PCB_HASH_ENTRIES];
+static uint32_t nr_shapes[PCB_HASH_NR_SHAPES];
+
+int
+pcb_hash_init(int socket_id)
+{
+	struct rte_hash_parameters params = {
+		.name = "pcb_hash",
+		.entries = PCB_HASH_ENTRIES,
+		.bucket_entries = 4,
+		.key_len = sizeof(struct pcb_hash_key),
+		.hash_func = rte_jhash,
+		.hash_func_init_val = 0,
+		.socket_id = socket_id,
+	};
+
+	pcb_hash = rte_hash_create(&params);
+	if (pcb_hash == NULL) {
+		RTE_LOG(ERR, APP, "Cannot create pcb hash\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int
+pcb_hash_shape(u32_t local_ip, u32_t remote_ip, u16_t remote_port)
+{
+	if (remote_ip == IPADDR_ANY && remote_port == 0)
+		return local_ip == IPADDR_ANY ?
+			PCB_HASH_LISTEN_ANY : PCB_HASH_LISTEN;
+	return local_ip == IPADDR_ANY ? PCB_HASH_EXACT_ANY : PCB_HASH_EXACT;
+}
+
+static void
+pcb_hash_key_init(struct pcb_hash_key *key, u8_t proto,
+		  u32_t local_ip, u16_t local_port,
+		  u32_t remote_ip, u16_t remote_port)
+{
+	memset(key, 0, sizeof(*key));
+	key->local_ip = local_ip;
+	key->remote_ip = remote_ip;
+	key->local_port = local_port;
+	key->remote_port = remote_port;
+	key->proto = proto;
+}
+
+int
+pcb_hash_add(u8_t proto, ip_addr_t *local_ip, u16_t local_port,
+	     ip_addr_t *remote_ip, u16_t remote_port, void *pcb)
+{
+	struct pcb_hash_key key;
+	u32_t lip = local_ip ? local_ip->addr : IPADDR_ANY;
+	u32_t rip = remote_ip ? remote_ip->addr : IPADDR_ANY;
+	int32_t pos;
+
+	pcb_hash_key_init(&key, proto, lip, local_port, rip, remote_port);
+
+	if (rte_hash_lookup(pcb_hash, &key) >= 0)
+		return -1;
+
+	pos = rte_hash_add_key(pcb_hash, &key);
+	if (pos < 0)
+		return -1;
+
+	pcbs[pos] = pcb;
+	nr_shapes[pcb_hash_shape(lip, rip, remote_port)]++;
+
+	return 0;
+}
+
+int
+pcb_hash_del(u8_t proto, ip_addr_t *local_ip, u16_t local_port,
+	     ip_addr_t *remote_ip, u16_t remote_port)
+{
+	struct pcb_hash_key key;
+	u32_t lip = local_ip ? local_ip->addr : IPADDR_ANY;
+	u32_t rip = remote_ip ? remote_ip->addr : IPADDR_ANY;
+	int32_t pos;
+
+	pcb_hash_key_init(&key, proto, lip, local_port, rip, remote_port);
+
+	pos = rte_hash_del_key(pcb_hash, &key);
+	if (pos < 0)
+		return -1;
+
+	pcbs[pos] = NULL;
+	nr_shapes[pcb_hash_shape(lip, rip, remote_port)]--;
+
+	return 0;
+}
+
+void *
+pcb_hash_lookup(u8_t proto, u32_t local_ip, u16_t local_port,
+		u32_t remote_ip, u16_t remote_port)
+{
+	struct pcb_hash_key key;
+	int32_t pos;
+
+	if (nr_shapes[PCB_HASH_EXACT]) {
+		pcb_hash_key_init(&key, proto, local_ip, local_port,
+				  remote_ip, remote_port);
+		pos = rte_hash_lookup(pcb_hash, &key);
+		if (pos >= 0)
+			return pcbs[pos];
+	}
+	if (nr_shapes[PCB_HASH_EXACT_ANY]) {
+		pcb_hash_key_init(&key, proto, IPADDR_ANY, local_port,
+				  remote_ip, remote_port);
+		pos = rte_hash_lookup(pcb_hash, &key);
+		if (pos >= 0)
+			return pcbs[pos];
+	}
+	if (nr_shapes[PCB_HASH_LISTEN]) {
+		pcb_hash_key_init(&key, proto, local_ip, local_port,
+				  IPADDR_ANY, 0);
+		pos = rte_hash_lookup(pcb_hash, &key);
+		if (pos >= 0)
+			return pcbs[pos];
+	}
+	if (nr_shapes[PCB_HASH_LISTEN_ANY]) {
+		pcb_hash_key_init(&key, proto, IPADDR_ANY, local_port,
+				  IPADDR_ANY, 0);
+		pos = rte_hash_lookup(pcb_hash, &key);
+		if (pos >= 0)
+			return pcbs[pos];
+	}
+	return NULL;
+}
@@ -0,0 +1,58 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _PCB_HASH_H_
+#define _PCB_HASH_H_
+
+#include <stdint.h>
+
+#include <lwip/ip_addr.h>
+
+/* Max number of bound and connected endpoints */
+#define PCB_HASH_ENTRIES	8192
+
+/*
+ * Endpoint demultiplexing on a hash table instead of lwIP's pcb lists.
+ * Lookups try the exact 4-tuple first and then the listening (local
+ * address and port only) entries, each with the specific local address
+ * before the wildcard one. Key shapes without any entry are skipped.
+ * The protocol is part of the key so that TCP pcbs can share the table.
+ */
+int pcb_hash_init(int socket_id);
+int pcb_hash_add(u8_t proto, ip_addr_t *local_ip, u16_t local_port,
+		 ip_addr_t *remote_ip, u16_t remote_port, void *pcb);
+int pcb_hash_del(u8_t proto, ip_addr_t *local_ip, u16_t local_port,
+		 ip_addr_t *remote_ip, u16_t remote_port);
+void * pcb_hash_lookup(u8_t proto, u32_t local_ip, u16_t local_port,
+		       u32_t remote_ip, u16_t remote_port);
+
+#endif
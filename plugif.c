@@ -39,15 +39,17 @@
 
 #include <netif/etharp.h>
 
+#include "convert.h"
+#include "ipfrag.h"
 #include "plugif.h"
-#include "mempool.h"
+#include "stats.h"
 
 struct plugif *
 plugif_alloc(int socket_id)
 {
 	struct plugif *plugif;
 
-	plugif = rte_zmalloc_socket("PLUGIF", sizeof(plugif), CACHE_LINE_SIZE,
+	plugif = rte_zmalloc_socket("PLUGIF", sizeof(*plugif), CACHE_LINE_SIZE,
 				    socket_id);
 	return plugif;
 }
@@ -77,26 +79,28 @@ plugif_init(struct plugif *plugif, struct rte_port_plug_params *params,
 err_t
 plugif_input(struct plugif *plugif, struct rte_mbuf *m)
 {
-	int len = rte_pktmbuf_pkt_len(m);
-	char *dat = rte_pktmbuf_mtod(m, char *);
-	struct pbuf *p, *q;
+	struct pbuf *p;
+	err_t err;
 
 	RTE_VERIFY(plugif->rte_port_type == RTE_PORT_TYPE_PLUG);
 
-	p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+	latency_record(rte_port_latency_local(&plugif->plug_port->rte_port), m,
+		       rte_rdtsc());
+
+	CYCLES_BEGIN(tsc);
+	p = mbuf_to_pbuf(m);
+	rte_pktmbuf_free(m);
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
 	if (p == 0) {
-		rte_pktmbuf_free(m);
-		plugif->plug_port->rte_port.stats.rx_dropped += 1;
+		rte_port_drop(&plugif->plug_port->rte_port, DROP_RX_PBUF, 1);
 		return ERR_OK;
 	}
 
-	for(q = p; q != NULL; q = q->next) {
-		rte_memcpy(q->payload, dat, q->len);
-		dat += q->len;
-	}
-	rte_pktmbuf_free(m);
+	CYCLES_BEGIN(lwip_tsc);
+	err = plugif->netif.input(p, &plugif->netif);
+	CYCLES_END(CYCLES_LWIP, lwip_tsc, 1);
 
-	return plugif->netif.input(p, &plugif->netif);
+	return err;
 }
 
 /* buffer ownership and responsivity [if_output]
@@ -109,8 +113,8 @@ low_level_output(struct netif *netif, struct pbuf *p)
 {
 	struct plugif *plugif = (struct plugif *)netif->state;
 	struct rte_port_plug *plug_port;
-	struct rte_mbuf *m;
-	struct pbuf *q;
+	struct rte_mbuf *m, *frags[IPFRAG_MAX_FRAGS];
+	int n;
 
 	RTE_VERIFY(plugif->rte_port_type == RTE_PORT_TYPE_PLUG);
 
@@ -119,20 +123,21 @@ low_level_output(struct netif *netif, struct pbuf *p)
 	if (!plug_port->rx_burst)
 		return ERR_OK;
 
-	m = rte_pktmbuf_alloc(pktmbuf_pool);
-	if (m == NULL)
+	CYCLES_BEGIN(tsc);
+	m = pbuf_to_mbuf(p, plug_port->rte_port.mempool);
+	if (m == NULL) {
+		rte_port_drop(&plug_port->rte_port, DROP_TX_MBUF, 1);
 		return ERR_MEM;
+	}
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
 
-	for(q = p; q != NULL; q = q->next) {
-		char *data = rte_pktmbuf_append(m, q->len);
-		if (data == NULL) {
-			rte_pktmbuf_free(m);
-			return ERR_MEM;
-		}
-		rte_memcpy(data, q->payload, q->len);
+	n = ipfrag_fragment(m, netif->mtu, frags, IPFRAG_MAX_FRAGS);
+	if (n < 0) {
+		rte_port_drop(&plug_port->rte_port, DROP_TX_FRAG, 1);
+		return ERR_MEM;
 	}
 
-	plug_port->rx_burst(plug_port, &m, 1);
+	plug_port->rx_burst(plug_port, frags, n);
 
 	return ERR_OK;
 }
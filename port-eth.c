@@ -37,10 +37,127 @@
 #include <rte_errno.h>
 #include <rte_malloc.h>
 
+#include "capture.h"
 #include "port-eth.h"
+#include "stats.h"
 
 static struct rte_port_ops rte_port_eth_ops;
 
+/* bonded device of each first member plus one, kept across port del and
+ * add as a bond cannot be freed
+ */
+static uint8_t bond_port_ids[RTE_MAX_ETHPORTS];
+
+/* bonded device of each member plus one, as a member is not a port */
+static uint8_t bond_members[RTE_MAX_ETHPORTS];
+
+static const uint8_t bond_xmit_policies[] = {
+	[NET_XMIT_L34] = BALANCE_XMIT_POLICY_LAYER34,
+	[NET_XMIT_L23] = BALANCE_XMIT_POLICY_LAYER23,
+	[NET_XMIT_L2]  = BALANCE_XMIT_POLICY_LAYER2,
+};
+
+/*
+ * Bonds the members into one device in balance mode, which hashes each
+ * TX frame to a member by policy and polls every member in turn on RX.
+ * The bond configures and starts the members along with itself. Returns
+ * its port_id, or -1.
+ */
+int
+rte_port_eth_bond(const uint8_t *members, uint8_t nr_members,
+		  net_xmit_policy policy, int socket_id)
+{
+	char name[STATS_NAME_SZ];
+	int port_id, i;
+
+	for (i = 0; i < nr_members; i++) {
+		if (bond_members[members[i]] &&
+		    bond_members[members[i]] != bond_port_ids[members[0]]) {
+			RTE_LOG(ERR, PORT, "Port %u is in another bond\n",
+				members[i]);
+			return -1;
+		}
+	}
+
+	if (bond_port_ids[members[0]])
+		return bond_port_ids[members[0]] - 1;
+
+	snprintf(name, sizeof(name), "bond%u", members[0]);
+	port_id = rte_eth_bond_create(name, BONDING_MODE_BALANCE, socket_id);
+	if (port_id < 0) {
+		RTE_LOG(ERR, PORT, "Cannot create bonded device %s\n", name);
+		return -1;
+	}
+
+	for (i = 0; i < nr_members; i++) {
+		if (rte_eth_bond_slave_add(port_id, members[i]) != 0) {
+			RTE_LOG(ERR, PORT, "Cannot add port %u to %s\n",
+				members[i], name);
+			return -1;
+		}
+		bond_members[members[i]] = port_id + 1;
+	}
+
+	if (rte_eth_bond_xmit_policy_set(port_id,
+					 bond_xmit_policies[policy]) != 0) {
+		RTE_LOG(ERR, PORT, "Cannot set the policy of %s\n", name);
+		return -1;
+	}
+
+	bond_port_ids[members[0]] = port_id + 1;
+	return port_id;
+}
+
+/* whether the device is a member of a bond */
+int
+rte_port_eth_bonded(uint8_t port_id)
+{
+	return bond_members[port_id] != 0;
+}
+
+/* reject queue and pool sizes the device cannot run with before
+ * anything is configured, so a bad config file fails at startup
+ */
+static int
+rte_port_eth_check(struct rte_port_eth_params *conf,
+		   struct rte_eth_dev_info *info)
+{
+	struct rte_mempool *mp = conf->rx_mempool ? : conf->mempool;
+	struct rte_pktmbuf_pool_private *priv = rte_mempool_get_priv(mp);
+	uint32_t room = priv->mbuf_data_room_size - RTE_PKTMBUF_HEADROOM;
+
+	if (conf->nb_rx_desc == 0 || conf->nb_tx_desc == 0) {
+		RTE_LOG(ERR, PORT, "Port %u has no rx/tx descriptors\n",
+			conf->port_id);
+		return -1;
+	}
+
+	if (room < info->min_rx_bufsize) {
+		RTE_LOG(ERR, PORT, "Port %u needs %u byte rx buffers, "
+			"pool has %u\n", conf->port_id,
+			info->min_rx_bufsize, room);
+		return -1;
+	}
+
+	if (conf->eth_conf.rxmode.jumbo_frame &&
+	    conf->eth_conf.rxmode.max_rx_pkt_len > info->max_rx_pktlen) {
+		RTE_LOG(ERR, PORT, "Port %u receives up to %u byte frames, "
+			"MTU %u needs %u\n", conf->port_id,
+			info->max_rx_pktlen, conf->mtu,
+			conf->eth_conf.rxmode.max_rx_pkt_len);
+		return -1;
+	}
+
+	/* every rx descriptor holds an mbuf, leave some for the burst */
+	if (conf->nb_rx_desc >= mp->size) {
+		RTE_LOG(ERR, PORT, "Port %u has %u rx descriptors, "
+			"pool has %u mbufs\n", conf->port_id,
+			conf->nb_rx_desc, mp->size);
+		return -1;
+	}
+	return 0;
+}
+
 struct rte_port_eth *
 rte_port_eth_create(struct rte_port_eth_params *conf,
 		    int socket_id,
@@ -48,8 +165,23 @@ rte_port_eth_create(struct rte_port_eth_params *conf,
 {
 	struct rte_port_eth *port;
 	uint8_t port_id = conf->port_id;
+	struct rte_eth_dev_info info;
+	char name[STATS_NAME_SZ];
 	int ret;
 
+	/* a frame larger than the data room of an mbuf is scattered
+	 * over several by the PMD
+	 */
+	if (conf->mtu > ETHER_MTU) {
+		conf->eth_conf.rxmode.jumbo_frame = 1;
+		conf->eth_conf.rxmode.max_rx_pkt_len =
+			conf->mtu + ETHER_HDR_LEN + ETHER_CRC_LEN;
+	}
+
+	rte_eth_dev_info_get(port_id, &info);
+	if (rte_port_eth_check(conf, &info) != 0)
+		return NULL;
+
 	port = rte_zmalloc_socket("PORT", sizeof(*port), CACHE_LINE_SIZE,
 				  socket_id);
         if (port == NULL) {
@@ -60,6 +192,12 @@ rte_port_eth_create(struct rte_port_eth_params *conf,
 	port->port_id = port_id;
 	port->rte_port.type = RTE_PORT_TYPE_ETH;
 	port->rte_port.ops = rte_port_eth_ops;
+	/* rte_eth_rx_queue_count() does not check for a missing callback */
+	if (rte_eth_devices[port_id].dev_ops->rx_queue_count == NULL)
+		port->rte_port.ops.rx_pending = NULL;
+	port->rte_port.mempool = conf->mempool;
+	port->rte_port.rx_mempool = conf->rx_mempool;
+	port->rte_port.rx_lowat = conf->rx_lowat;
 
 	ret = rte_eth_dev_configure(port_id, 1, 1, &conf->eth_conf);
 	if (ret < 0) {
@@ -70,7 +208,8 @@ rte_port_eth_create(struct rte_port_eth_params *conf,
 	}
 
 	ret = rte_eth_rx_queue_setup(port_id, 0, conf->nb_rx_desc, socket_id,
-				     &conf->rx_conf, conf->mempool);
+				     &conf->rx_conf,
+				     conf->rx_mempool ? : conf->mempool);
 	if (ret < 0) {
 		RTE_LOG(ERR, PORT, "Cannot setup rx queue: %s\n",
 			rte_strerror(-ret));
@@ -99,6 +238,14 @@ rte_port_eth_create(struct rte_port_eth_params *conf,
 
 	rte_eth_dev_info_get(port_id, &port->eth_dev_info);
 
+	/* last, so that no failure leaves the stats with a freed port */
+	snprintf(name, sizeof(name), "eth%u", port_id);
+	if (stats_port_register(&port->rte_port, name) != 0) {
+		rte_eth_dev_stop(port_id);
+		rte_free(port);
+		return NULL;
+	}
+
 	net_port->rte_port = &port->rte_port;
 
 	return port;
@@ -109,6 +256,7 @@ rte_port_eth_rx_burst(struct rte_port *rte_port,
 		      struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct rte_port_eth *p;
+	struct rte_port_stats *stats;
 	int rx;
 
 	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_ETH);
@@ -121,7 +269,14 @@ rte_port_eth_rx_burst(struct rte_port *rte_port,
 		return rx;
 	}
 
-	p->rte_port.stats.rx_packets += rx;
+	stats = rte_port_stats(&p->rte_port);
+	stats->rx_bursts += 1;
+	stats->rx_empty += (rx == 0);
+	stats->rx_packets += rx;
+	stats->rx_bytes += stats_burst_bytes(pkts, rx);
+
+	mbuf_tsc_set_burst(pkts, rx, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_RX, pkts, rx);
 
 	return rx;
 }
@@ -135,25 +290,51 @@ rte_port_eth_tx_burst(struct rte_port *rte_port,
 		      struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct rte_port_eth *p;
+	struct rte_port_stats *stats;
+	uint64_t bytes;
 	int tx;
 
 	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_ETH);
 
 	p = container_of(rte_port, struct rte_port_eth, rte_port);
 
+	stats = rte_port_stats(&p->rte_port);
+	bytes = stats_burst_bytes(pkts, n_pkts);
+	latency_record_burst(rte_port_latency_tx(&p->rte_port),
+			     pkts, n_pkts, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_TX, pkts, n_pkts);
+
+	CYCLES_BEGIN(tsc);
 	tx = rte_eth_tx_burst(p->port_id, 0, pkts, n_pkts);
-	p->rte_port.stats.tx_packets += tx;
+	CYCLES_END(CYCLES_TX, tsc, tx);
+	stats->tx_packets += tx;
+	trace(TRACE_TX_BURST, 0, p->rte_port.stats_id, tx);
 
 	if (unlikely(tx < n_pkts)) {
+		rte_port_drop(&p->rte_port, DROP_TX_FULL, n_pkts - tx);
 		for (; tx < n_pkts; tx++) {
+			bytes -= pkts[tx]->pkt.pkt_len;
 			rte_pktmbuf_free(pkts[tx]);
-			p->rte_port.stats.tx_dropped += 1;
 		}
         }
+	stats->tx_bytes += bytes;
 	return tx;
 }
 
+static uint32_t
+rte_port_eth_rx_pending(struct rte_port *rte_port)
+{
+	struct rte_port_eth *p;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_ETH);
+
+	p = container_of(rte_port, struct rte_port_eth, rte_port);
+
+	return rte_eth_rx_queue_count(p->port_id, 0);
+}
+
 static struct rte_port_ops rte_port_eth_ops = {
 	.rx_burst = rte_port_eth_rx_burst,
-	.tx_burst = rte_port_eth_tx_burst
+	.tx_burst = rte_port_eth_tx_burst,
+	.rx_pending = rte_port_eth_rx_pending
 };
@@ -34,6 +34,7 @@
 #define _PORT_ETH_H_
 
 #include <rte_ethdev.h>
+#include <rte_eth_bond.h>
 
 #include "port.h"
 
@@ -41,10 +42,13 @@ struct rte_port_eth_params {
 	uint8_t			 port_id;
 	uint16_t		 nb_rx_desc;
 	uint16_t		 nb_tx_desc;
+	uint16_t		 mtu;		/* jumbo frames above 1500 */
 	struct rte_eth_conf	 eth_conf;
 	struct rte_eth_rxconf	 rx_conf;
 	struct rte_eth_txconf	 tx_conf;
 	struct rte_mempool	*mempool;
+	struct rte_mempool	*rx_mempool;	/* instead of mempool for RX */
+	uint32_t		 rx_lowat;
 };
 
 struct rte_port_eth {
@@ -56,6 +60,9 @@ struct rte_port_eth {
 struct rte_port_eth * rte_port_eth_create
 	(struct rte_port_eth_params *conf, int socket_id,
 	 struct net_port *net_port);
+int rte_port_eth_bond(const uint8_t *members, uint8_t nr_members,
+		      net_xmit_policy policy, int socket_id);
+int rte_port_eth_bonded(uint8_t port_id);
 int rte_port_eth_tx_burst
 	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
 
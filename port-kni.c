@@ -36,10 +36,23 @@
 
 #include <rte_malloc.h>
 
+#include "capture.h"
 #include "port-kni.h"
+#include "stats.h"
 
 static struct rte_port_ops rte_port_kni_ops;
 
+/* the requests are rare and rte_kni_handle_request() takes a system
+ * call, so they are not handled on every poll
+ */
+static void
+rte_port_kni_request_cb(struct wheel_timer *timer, void *arg)
+{
+	struct rte_port_kni *port = (struct rte_port_kni *)arg;
+
+	rte_kni_handle_request(port->kni);
+}
+
 struct rte_port_kni *
 rte_port_kni_create(struct rte_port_kni_params *conf,
 		    int socket_id,
@@ -57,32 +70,60 @@ rte_port_kni_create(struct rte_port_kni_params *conf,
 		return NULL;
 	}
 
+	port->rte_port.type = RTE_PORT_TYPE_KNI;
+	port->rte_port.ops = rte_port_kni_ops;
+	port->rte_port.mempool = conf->mempool;
+	port->rte_port.rx_mempool = conf->rx_mempool;
+	port->rte_port.rx_lowat = conf->rx_lowat;
+
 	memset(&kni_conf, 0, sizeof(kni_conf));
 	snprintf(kni_conf.name, RTE_KNI_NAMESIZE, "%s", conf->name);
 	kni_conf.mbuf_size = conf->mbuf_size;
 
 	memset(&kni_ops, 0, sizeof(kni_ops));
 
-	port->kni = rte_kni_alloc(conf->mempool, &kni_conf, &kni_ops);
+	port->kni = rte_kni_alloc(conf->rx_mempool ? : conf->mempool,
+				  &kni_conf, &kni_ops);
 	if (port->kni == NULL) {
                 RTE_LOG(ERR, PORT, "Cannot allocate kni instance\n");
 		rte_free(port);
 		return NULL;
 	}
 
-	port->rte_port.type = RTE_PORT_TYPE_KNI;
-	port->rte_port.ops = rte_port_kni_ops;
+	if (stats_port_register(&port->rte_port, conf->name) != 0) {
+		rte_kni_release(port->kni);
+		rte_free(port);
+		return NULL;
+	}
+
+	wheel_timer_init(&port->request_timer);
 
 	net_port->rte_port = &port->rte_port;
 
 	return port;
 }
 
+/* on the dispatch lcore, which polls the timer wheel */
+void
+rte_port_kni_start(struct rte_port_kni *port)
+{
+	wheel_timer_start(&port->request_timer, KNI_REQUEST_MS,
+			  KNI_REQUEST_MS, rte_port_kni_request_cb, port);
+}
+
+/* on the dispatch lcore, before the KNI is released */
+void
+rte_port_kni_stop(struct rte_port_kni *port)
+{
+	wheel_timer_stop(&port->request_timer);
+}
+
 int
 rte_port_kni_rx_burst(struct rte_port *rte_port,
 		      struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct rte_port_kni *p;
+	struct rte_port_stats *stats;
 	int rx;
 
 	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_KNI);
@@ -95,9 +136,14 @@ rte_port_kni_rx_burst(struct rte_port *rte_port,
 		return rx;
 	}
 
-	p->rte_port.stats.rx_packets += rx;
+	stats = rte_port_stats(&p->rte_port);
+	stats->rx_bursts += 1;
+	stats->rx_empty += (rx == 0);
+	stats->rx_packets += rx;
+	stats->rx_bytes += stats_burst_bytes(pkts, rx);
 
-	rte_kni_handle_request(p->kni);
+	mbuf_tsc_set_burst(pkts, rx, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_RX, pkts, rx);
 
 	return rx;
 }
@@ -111,21 +157,46 @@ rte_port_kni_tx_burst(struct rte_port *rte_port,
 		      struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct rte_port_kni *p;
+	struct rte_port_stats *stats;
+	uint64_t bytes;
+	uint32_t i, n;
 	int tx;
 
 	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_KNI);
 
 	p = container_of(rte_port, struct rte_port_kni, rte_port);
 
+	/* the KNI module only copies the first segment of a frame */
+	for (i = n = 0; i < n_pkts; i++) {
+		if (unlikely(pkts[i]->pkt.nb_segs > 1)) {
+			rte_port_drop(&p->rte_port, DROP_TX_SEGS, 1);
+			rte_pktmbuf_free(pkts[i]);
+			continue;
+		}
+		pkts[n++] = pkts[i];
+	}
+	n_pkts = n;
+
+	stats = rte_port_stats(&p->rte_port);
+	bytes = stats_burst_bytes(pkts, n_pkts);
+	latency_record_burst(rte_port_latency_tx(&p->rte_port),
+			     pkts, n_pkts, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_TX, pkts, n_pkts);
+
+	CYCLES_BEGIN(tsc);
 	tx = rte_kni_tx_burst(p->kni, pkts, n_pkts);
-	p->rte_port.stats.tx_packets += tx;
+	CYCLES_END(CYCLES_TX, tsc, tx);
+	stats->tx_packets += tx;
+	trace(TRACE_TX_BURST, 0, p->rte_port.stats_id, tx);
 
 	if (unlikely(tx < n_pkts)) {
+		rte_port_drop(&p->rte_port, DROP_TX_FULL, n_pkts - tx);
 		for (; tx < n_pkts; tx++) {
+			bytes -= pkts[tx]->pkt.pkt_len;
 			rte_pktmbuf_free(pkts[tx]);
-			p->rte_port.stats.tx_dropped += 1;
 		}
         }
+	stats->tx_bytes += bytes;
 	return tx;
 }
 
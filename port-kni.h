@@ -36,21 +36,30 @@
 #include <rte_kni.h>
 
 #include "port.h"
+#include "wheel.h"
+
+/* Period of the MTU and link requests from the kernel */
+#define KNI_REQUEST_MS		100
 
 struct rte_port_kni_params {
 	char			*name;
 	struct rte_mempool	*mempool;
 	unsigned		 mbuf_size;
+	struct rte_mempool	*rx_mempool;	/* instead of mempool for RX */
+	uint32_t		 rx_lowat;
 };
 
 struct rte_port_kni {
 	struct rte_kni		*kni;
+	struct wheel_timer	 request_timer;
 	struct rte_port		 rte_port;
 };
 
 struct rte_port_kni * rte_port_kni_create
 	(struct rte_port_kni_params *conf, int socket_id,
 	 struct net_port *net_port);
+void rte_port_kni_start(struct rte_port_kni *port);
+void rte_port_kni_stop(struct rte_port_kni *port);
 int rte_port_kni_tx_burst
 	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
 
@@ -36,7 +36,10 @@
 
 #include <rte_malloc.h>
 
+#include "capture.h"
+#include "mempool.h"
 #include "port-plug.h"
+#include "stats.h"
 
 static struct rte_port_ops rte_port_plug_ops;
 
@@ -60,6 +63,16 @@ rte_port_plug_create(struct rte_port_plug_params *conf,
 
 	port->rte_port.type = RTE_PORT_TYPE_PLUG;
 	port->rte_port.ops  = rte_port_plug_ops;
+	port->rte_port.mempool = mempool_get(socket_id);
+	if (port->rte_port.mempool == NULL) {
+		rte_free(port);
+		return NULL;
+	}
+
+	if (stats_port_register(&port->rte_port, "plug") != 0) {
+		rte_free(port);
+		return NULL;
+	}
 
 	net_port->rte_port  = &port->rte_port;
 
@@ -75,23 +88,36 @@ rte_port_plug_tx_burst(struct rte_port *rte_port,
 		       struct rte_mbuf **pkts, uint32_t n_pkts)
 {
 	struct rte_port_plug *p;
+	struct rte_port_stats *stats;
+	uint64_t bytes;
 	int tx = 0;
 
 	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_PLUG);
 
 	p = container_of(rte_port, struct rte_port_plug, rte_port);
 
+	stats = rte_port_stats(&p->rte_port);
+	bytes = stats_burst_bytes(pkts, n_pkts);
+	latency_record_burst(rte_port_latency_tx(&p->rte_port),
+			     pkts, n_pkts, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_TX, pkts, n_pkts);
+
+	CYCLES_BEGIN(tsc);
 	if (p->tx_burst)
 		tx = p->tx_burst(p, pkts, n_pkts);
+	CYCLES_END(CYCLES_TX, tsc, tx);
 
-	p->rte_port.stats.tx_packets += tx;
+	stats->tx_packets += tx;
+	trace(TRACE_TX_BURST, 0, p->rte_port.stats_id, tx);
 
 	if (unlikely(tx < n_pkts)) {
+		rte_port_drop(&p->rte_port, DROP_TX_FULL, n_pkts - tx);
 		for (; tx < n_pkts; tx++) {
+			bytes -= pkts[tx]->pkt.pkt_len;
 			rte_pktmbuf_free(pkts[tx]);
-			p->rte_port.stats.tx_dropped += 1;
 		}
         }
+	stats->tx_bytes += bytes;
 	return tx;
 }
 
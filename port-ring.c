@@ -0,0 +1,184 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rte_malloc.h>
+
+#include "capture.h"
+#include "port-ring.h"
+#include "stats.h"
+
+static struct rte_port_ops rte_port_ring_ops;
+
+static struct rte_ring *
+rte_port_ring_get(const char *name, const char *dir, uint32_t size,
+		  int socket_id, unsigned flags)
+{
+	char ring_name[RTE_RING_NAMESIZE];
+	struct rte_ring *r;
+
+	snprintf(ring_name, sizeof(ring_name), "%s_%s", name, dir);
+
+	r = rte_ring_lookup(ring_name);
+	if (r)
+		return r;
+
+	r = rte_ring_create(ring_name, size, socket_id, flags);
+	if (r == NULL)
+		RTE_LOG(ERR, PORT, "Cannot create ring %s\n", ring_name);
+	return r;
+}
+
+struct rte_port_ring *
+rte_port_ring_create(struct rte_port_ring_params *conf,
+		     int socket_id,
+		     struct net_port *net_port)
+{
+	struct rte_port_ring *port;
+
+	port = rte_zmalloc_socket("PORT", sizeof(*port), CACHE_LINE_SIZE,
+				  socket_id);
+	if (port == NULL) {
+		RTE_LOG(ERR, PORT, "Cannot allocate ring port\n");
+		return NULL;
+	}
+
+	port->rte_port.type = RTE_PORT_TYPE_RING;
+	port->rte_port.ops = rte_port_ring_ops;
+	port->rte_port.mempool = conf->mempool;
+
+	/* only this port dequeues rx and enqueues tx */
+	port->rx = rte_port_ring_get(conf->name, "rx", conf->size, socket_id,
+				     RING_F_SC_DEQ);
+	port->tx = rte_port_ring_get(conf->name, "tx", conf->size, socket_id,
+				     RING_F_SP_ENQ);
+	if (port->rx == NULL || port->tx == NULL) {
+		rte_free(port);
+		return NULL;
+	}
+
+	if (stats_port_register(&port->rte_port, conf->name) != 0) {
+		rte_free(port);
+		return NULL;
+	}
+
+	net_port->rte_port = &port->rte_port;
+
+	return port;
+}
+
+static int
+rte_port_ring_rx_burst(struct rte_port *rte_port,
+		       struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_ring *p;
+	struct rte_port_stats *stats;
+	int rx;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_RING);
+
+	p = container_of(rte_port, struct rte_port_ring, rte_port);
+
+	rx = rte_ring_sc_dequeue_burst(p->rx, (void **)pkts, n_pkts);
+
+	stats = rte_port_stats(&p->rte_port);
+	stats->rx_bursts += 1;
+	stats->rx_empty += (rx == 0);
+	stats->rx_packets += rx;
+	stats->rx_bytes += stats_burst_bytes(pkts, rx);
+
+	mbuf_tsc_set_burst(pkts, rx, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_RX, pkts, rx);
+
+	return rx;
+}
+
+/* buffer ownership and responsivity [tx_burst]
+ *   mbuf: transfer the ownership of all mbuf enqueued successfully to
+ *         the process on the other side, otherwise free all here
+ */
+int
+rte_port_ring_tx_burst(struct rte_port *rte_port,
+		       struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_ring *p;
+	struct rte_port_stats *stats;
+	uint64_t bytes;
+	int tx;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_RING);
+
+	p = container_of(rte_port, struct rte_port_ring, rte_port);
+
+	stats = rte_port_stats(&p->rte_port);
+	bytes = stats_burst_bytes(pkts, n_pkts);
+	latency_record_burst(rte_port_latency_tx(&p->rte_port),
+			     pkts, n_pkts, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_TX, pkts, n_pkts);
+
+	CYCLES_BEGIN(tsc);
+	tx = rte_ring_sp_enqueue_burst(p->tx, (void **)pkts, n_pkts);
+	CYCLES_END(CYCLES_TX, tsc, tx);
+	stats->tx_packets += tx;
+	trace(TRACE_TX_BURST, 0, p->rte_port.stats_id, tx);
+
+	if (unlikely(tx < n_pkts)) {
+		rte_port_drop(&p->rte_port, DROP_TX_FULL, n_pkts - tx);
+		for (; tx < n_pkts; tx++) {
+			bytes -= pkts[tx]->pkt.pkt_len;
+			rte_pktmbuf_free(pkts[tx]);
+		}
+	}
+	stats->tx_bytes += bytes;
+	return tx;
+}
+
+static uint32_t
+rte_port_ring_rx_pending(struct rte_port *rte_port)
+{
+	struct rte_port_ring *p;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_RING);
+
+	p = container_of(rte_port, struct rte_port_ring, rte_port);
+
+	return rte_ring_count(p->rx);
+}
+
+static struct rte_port_ops rte_port_ring_ops = {
+	.rx_burst = rte_port_ring_rx_burst,
+	.tx_burst = rte_port_ring_tx_burst,
+	.rx_pending = rte_port_ring_rx_pending,
+};
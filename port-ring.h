@@ -0,0 +1,68 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _PORT_RING_H_
+#define _PORT_RING_H_
+
+#include <rte_ring.h>
+
+#include "port.h"
+
+/* Default number of mbufs in each ring of a ring port */
+#define RING_PORT_SIZE_DEFAULT	1024
+
+/*
+ * A ring port exchanges mbufs by pointer with another DPDK process
+ * through <name>_rx, which the port dequeues, and <name>_tx, which it
+ * enqueues. Whichever process comes first creates both rings in the
+ * shared memory, so the mbufs have to come from pools the other side
+ * can reach too.
+ */
+struct rte_port_ring_params {
+	char			*name;
+	uint32_t		 size;		/* power of 2 */
+	struct rte_mempool	*mempool;	/* for lwIP output */
+};
+
+struct rte_port_ring {
+	struct rte_ring		*rx;
+	struct rte_ring		*tx;
+	struct rte_port		 rte_port;
+};
+
+struct rte_port_ring * rte_port_ring_create
+	(struct rte_port_ring_params *conf, int socket_id,
+	 struct net_port *net_port);
+int rte_port_ring_tx_burst
+	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
+
+#endif
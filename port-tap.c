@@ -0,0 +1,353 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+
+#include <rte_ether.h>
+#include <rte_udp.h>
+#include <rte_malloc.h>
+
+#include "capture.h"
+#include "port-tap.h"
+#include "stats.h"
+
+static struct rte_port_ops rte_port_tap_ops;
+
+/* sets the MTU of the TAP device and brings it up, so the kernel never
+ * sends frames larger than the RX buffers
+ */
+static int
+rte_port_tap_up(const char *name, uint16_t mtu)
+{
+	struct ifreq ifr;
+	int fd, ret = -1;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", name);
+	ifr.ifr_mtu = mtu;
+	if (ioctl(fd, SIOCSIFMTU, &ifr) < 0)
+		goto out;
+
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr) < 0)
+		goto out;
+	ifr.ifr_flags |= IFF_UP;
+	if (ioctl(fd, SIOCSIFFLAGS, &ifr) < 0)
+		goto out;
+
+	ret = 0;
+out:
+	close(fd);
+	return ret;
+}
+
+struct rte_port_tap *
+rte_port_tap_create(struct rte_port_tap_params *conf,
+		    int socket_id,
+		    struct net_port *net_port)
+{
+	struct rte_port_tap *port;
+	struct rte_mempool *mp = conf->rx_mempool ? : conf->mempool;
+	struct rte_pktmbuf_pool_private *priv = rte_mempool_get_priv(mp);
+	uint32_t room = priv->mbuf_data_room_size - RTE_PKTMBUF_HEADROOM;
+	uint32_t frame = conf->mtu + ETHER_HDR_LEN + 4;	/* with a VLAN tag */
+	struct ifreq ifr;
+
+	port = rte_zmalloc_socket("PORT", sizeof(*port), CACHE_LINE_SIZE,
+				  socket_id);
+	if (port == NULL) {
+		RTE_LOG(ERR, PORT, "Cannot allocate tap port\n");
+		return NULL;
+	}
+
+	port->rte_port.type = RTE_PORT_TYPE_TAP;
+	port->rte_port.ops = rte_port_tap_ops;
+	port->rte_port.mempool = conf->mempool;
+	port->rte_port.rx_mempool = conf->rx_mempool;
+	port->rte_port.rx_lowat = conf->rx_lowat;
+	port->rx_segs = (frame + room - 1) / room;
+	if (port->rx_segs > TAP_SEGS_MAX) {
+		RTE_LOG(ERR, PORT, "Tap %s needs %u mbufs per frame\n",
+			conf->name, port->rx_segs);
+		rte_free(port);
+		return NULL;
+	}
+
+	port->fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+	if (port->fd < 0) {
+		RTE_LOG(ERR, PORT, "Cannot open /dev/net/tun: %s\n",
+			strerror(errno));
+		rte_free(port);
+		return NULL;
+	}
+
+	/* no TUN_F_* offload is set, so the kernel sends complete
+	 * checksums and no GSO frames
+	 */
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
+	snprintf(ifr.ifr_name, IFNAMSIZ, "%s", conf->name);
+	if (ioctl(port->fd, TUNSETIFF, &ifr) < 0 ||
+	    rte_port_tap_up(conf->name, conf->mtu) != 0) {
+		RTE_LOG(ERR, PORT, "Cannot set up tap %s: %s\n",
+			conf->name, strerror(errno));
+		goto fail;
+	}
+
+	if (stats_port_register(&port->rte_port, conf->name) != 0)
+		goto fail;
+
+	net_port->rte_port = &port->rte_port;
+
+	return port;
+
+fail:
+	close(port->fd);
+	rte_free(port);
+	return NULL;
+}
+
+/* closing the descriptor removes the TAP device; the rte_port stays for
+ * the statistics
+ */
+void
+rte_port_tap_release(struct rte_port_tap *port)
+{
+	close(port->fd);
+	port->fd = -1;
+}
+
+/* reads a frame into a chain of rx_segs mbufs and frees the unused
+ * ones; returns 1 with the frame in *pkt, 0 for a frame dropped, or -1
+ * once the kernel has nothing more
+ */
+static int
+rte_port_tap_read(struct rte_port_tap *p, struct rte_mempool *mp,
+		  struct rte_mbuf **pkt)
+{
+	struct rte_mbuf *segs[TAP_SEGS_MAX], *m;
+	struct iovec iov[1 + TAP_SEGS_MAX];
+	struct virtio_net_hdr hdr;
+	uint32_t i, n = p->rx_segs, cap = 0;
+	ssize_t len;
+
+	for (i = 0; i < n; i++) {
+		segs[i] = rte_pktmbuf_alloc(mp);
+		if (segs[i] == NULL) {
+			/* the frames wait in the kernel for free mbufs */
+			while (i > 0)
+				rte_pktmbuf_free(segs[--i]);
+			return -1;
+		}
+		iov[1 + i].iov_base = rte_pktmbuf_mtod(segs[i], void *);
+		iov[1 + i].iov_len = rte_pktmbuf_tailroom(segs[i]);
+		cap += iov[1 + i].iov_len;
+	}
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+
+	len = readv(p->fd, iov, 1 + n);
+	if (len <= (ssize_t)sizeof(hdr)) {
+		for (i = 0; i < n; i++)
+			rte_pktmbuf_free(segs[i]);
+		return -1;
+	}
+	len -= sizeof(hdr);
+
+	if (unlikely((size_t)len > cap)) {
+		rte_port_drop(&p->rte_port, DROP_RX_TRUNC, 1);
+		for (i = 0; i < n; i++)
+			rte_pktmbuf_free(segs[i]);
+		return 0;
+	}
+
+	m = segs[0];
+	m->pkt.pkt_len = len;
+	m->pkt.nb_segs = 0;
+	for (i = 0; i < n && len > 0; i++) {
+		segs[i]->pkt.data_len = RTE_MIN((uint32_t)len,
+						(uint32_t)iov[1 + i].iov_len);
+		len -= segs[i]->pkt.data_len;
+		if (i > 0)
+			segs[i - 1]->pkt.next = segs[i];
+		m->pkt.nb_segs++;
+	}
+	for (; i < n; i++)
+		rte_pktmbuf_free(segs[i]);
+
+	*pkt = m;
+	return 1;
+}
+
+static int
+rte_port_tap_rx_burst(struct rte_port *rte_port,
+		      struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_tap *p;
+	struct rte_port_stats *stats;
+	struct rte_mempool *mp;
+	uint32_t rx = 0;
+	int ret;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_TAP);
+
+	p = container_of(rte_port, struct rte_port_tap, rte_port);
+	mp = p->rte_port.rx_mempool ? : p->rte_port.mempool;
+
+	while (rx < n_pkts) {
+		ret = rte_port_tap_read(p, mp, &pkts[rx]);
+		if (ret < 0)
+			break;
+		rx += ret;
+	}
+
+	stats = rte_port_stats(&p->rte_port);
+	stats->rx_bursts += 1;
+	stats->rx_empty += (rx == 0);
+	stats->rx_packets += rx;
+	stats->rx_bytes += stats_burst_bytes(pkts, rx);
+
+	mbuf_tsc_set_burst(pkts, rx, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_RX, pkts, rx);
+
+	return rx;
+}
+
+/* fills the virtio-net header of a frame sent to the kernel: a UDP
+ * checksum left to the offload, see udp_mbuf_send_burst(), is only the
+ * pseudo header sum and the kernel completes it
+ */
+static inline void
+rte_port_tap_hdr(struct rte_mbuf *m, struct virtio_net_hdr *hdr)
+{
+	memset(hdr, 0, sizeof(*hdr));
+
+	if ((m->ol_flags & PKT_TX_L4_MASK) == PKT_TX_UDP_CKSUM) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = m->pkt.vlan_macip.f.l2_len +
+			m->pkt.vlan_macip.f.l3_len;
+		hdr->csum_offset = offsetof(struct udp_hdr, dgram_cksum);
+	}
+}
+
+/* buffer ownership and responsivity [tx_burst]
+ *   mbuf: the kernel gets copies, free all here
+ */
+int
+rte_port_tap_tx_burst(struct rte_port *rte_port,
+		      struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_tap *p;
+	struct rte_port_stats *stats;
+	struct iovec iov[1 + TAP_SEGS_MAX];
+	struct virtio_net_hdr hdr;
+	struct rte_mbuf *seg;
+	uint64_t bytes = 0;
+	uint32_t i, tx = 0;
+	int n;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_TAP);
+
+	p = container_of(rte_port, struct rte_port_tap, rte_port);
+
+	stats = rte_port_stats(&p->rte_port);
+	latency_record_burst(rte_port_latency_tx(&p->rte_port),
+			     pkts, n_pkts, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_TX, pkts, n_pkts);
+
+	CYCLES_BEGIN(tsc);
+	for (i = 0; i < n_pkts; i++) {
+		if (unlikely(pkts[i]->pkt.nb_segs > TAP_SEGS_MAX)) {
+			rte_port_drop(&p->rte_port, DROP_TX_SEGS, 1);
+			continue;
+		}
+
+		rte_port_tap_hdr(pkts[i], &hdr);
+		iov[0].iov_base = &hdr;
+		iov[0].iov_len = sizeof(hdr);
+		for (seg = pkts[i], n = 1; seg != NULL; seg = seg->pkt.next) {
+			iov[n].iov_base = rte_pktmbuf_mtod(seg, void *);
+			iov[n++].iov_len = rte_pktmbuf_data_len(seg);
+		}
+
+		if (writev(p->fd, iov, n) < 0) {
+			/* the TAP queue is full or the device is down */
+			rte_port_drop(&p->rte_port, DROP_TX_FULL, 1);
+			continue;
+		}
+		tx++;
+		bytes += pkts[i]->pkt.pkt_len;
+	}
+	CYCLES_END(CYCLES_TX, tsc, tx);
+	stats->tx_packets += tx;
+	stats->tx_bytes += bytes;
+	trace(TRACE_TX_BURST, 0, p->rte_port.stats_id, tx);
+
+	for (i = 0; i < n_pkts; i++)
+		rte_pktmbuf_free(pkts[i]);
+
+	return tx;
+}
+
+static int
+rte_port_tap_rx_fd(struct rte_port *rte_port)
+{
+	struct rte_port_tap *p;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_TAP);
+
+	p = container_of(rte_port, struct rte_port_tap, rte_port);
+
+	return p->fd;
+}
+
+static struct rte_port_ops rte_port_tap_ops = {
+	.rx_burst = rte_port_tap_rx_burst,
+	.tx_burst = rte_port_tap_tx_burst,
+	.rx_fd = rte_port_tap_rx_fd,
+};
@@ -0,0 +1,71 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _PORT_TAP_H_
+#define _PORT_TAP_H_
+
+#include <net/if.h>
+
+#include "port.h"
+
+/* Segments of a frame exchanged with the kernel at once */
+#define TAP_SEGS_MAX		32
+
+/*
+ * A TAP port is the exception path to the kernel without the KNI
+ * module: frames are read from and written to a TAP device opened with
+ * IFF_VNET_HDR, one system call per frame and up to a burst per poll.
+ * The virtio-net header in front of each frame carries the checksum
+ * offload of the frames sent to the kernel, see rte_port_tap_hdr().
+ */
+struct rte_port_tap_params {
+	char			*name;		/* of the TAP device */
+	uint16_t		 mtu;
+	struct rte_mempool	*mempool;	/* for lwIP output */
+	struct rte_mempool	*rx_mempool;	/* own RX pool */
+	uint32_t		 rx_lowat;
+};
+
+struct rte_port_tap {
+	int			 fd;
+	uint32_t		 rx_segs;	/* mbufs per frame */
+	struct rte_port		 rte_port;
+};
+
+struct rte_port_tap * rte_port_tap_create
+	(struct rte_port_tap_params *conf, int socket_id,
+	 struct net_port *net_port);
+void rte_port_tap_release(struct rte_port_tap *port);
+int rte_port_tap_tx_burst
+	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
+
+#endif
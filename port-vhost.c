@@ -0,0 +1,307 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+
+#include <rte_launch.h>
+#include <rte_malloc.h>
+#include <rte_spinlock.h>
+
+#include "capture.h"
+#include "main.h"
+#include "port-vhost.h"
+#include "rcu.h"
+#include "stats.h"
+
+static struct rte_port_ops rte_port_vhost_ops;
+
+/* vhost ports a new guest can be bound to, see vhost_new_device() */
+static struct rte_port_vhost *vhost_ports[VHOST_PORT_MAX];
+static rte_spinlock_t vhost_lock = RTE_SPINLOCK_INITIALIZER;
+static int vhost_started;
+
+/*
+ * Run on the session lcore of the vhost library
+ */
+
+static int
+vhost_new_device(struct virtio_net *dev)
+{
+	int i;
+
+	rte_spinlock_lock(&vhost_lock);
+	for (i = 0; i < VHOST_PORT_MAX; i++) {
+		if (vhost_ports[i] && vhost_ports[i]->dev == NULL)
+			break;
+	}
+	if (i == VHOST_PORT_MAX) {
+		rte_spinlock_unlock(&vhost_lock);
+		RTE_LOG(ERR, PORT, "No vhost port for device %"PRIu64"\n",
+			dev->device_fh);
+		return -1;
+	}
+
+	/* the dispatch lcore polls, the guest need not kick it */
+	rte_vhost_enable_guest_notification(dev, VIRTIO_RXQ, 0);
+	rte_vhost_enable_guest_notification(dev, VIRTIO_TXQ, 0);
+	dev->flags |= VIRTIO_DEV_RUNNING;
+
+	rte_wmb();
+	vhost_ports[i]->dev = dev;
+	rte_spinlock_unlock(&vhost_lock);
+
+	RTE_LOG(INFO, PORT, "Device %"PRIu64" bound to vhost port %d\n",
+		dev->device_fh, i);
+	return 0;
+}
+
+/* the library unmaps the guest memory on return, so wait for the
+ * dispatch round that may still use the device
+ */
+static void
+vhost_destroy_device(volatile struct virtio_net *dev)
+{
+	int i;
+
+	rte_spinlock_lock(&vhost_lock);
+	for (i = 0; i < VHOST_PORT_MAX; i++) {
+		if (vhost_ports[i] && vhost_ports[i]->dev == dev)
+			vhost_ports[i]->dev = NULL;
+	}
+	rte_spinlock_unlock(&vhost_lock);
+
+	rcu_synchronize();
+	dev->flags &= ~VIRTIO_DEV_RUNNING;
+
+	RTE_LOG(INFO, PORT, "Device %"PRIu64" removed\n", dev->device_fh);
+}
+
+static const struct virtio_net_device_ops vhost_device_ops = {
+	.new_device = vhost_new_device,
+	.destroy_device = vhost_destroy_device,
+};
+
+static int
+vhost_session(__attribute__((unused)) void *arg)
+{
+	rte_vhost_driver_session_start();
+	return 0;
+}
+
+/* registers the character device once, for the first vhost port; run on
+ * the master lcore, which launches the session
+ */
+int
+rte_port_vhost_start(void)
+{
+	unsigned lcore_id;
+
+	if (vhost_started)
+		return 0;
+
+	lcore_id = spare_lcore();
+	if (lcore_id >= RTE_MAX_LCORE) {
+		RTE_LOG(ERR, PORT, "No spare lcore for the vhost session\n");
+		return -1;
+	}
+
+	if (rte_vhost_driver_register(VHOST_DEV_BASENAME) != 0) {
+		RTE_LOG(ERR, PORT, "Cannot register vhost device %s\n",
+			VHOST_DEV_BASENAME);
+		return -1;
+	}
+	rte_vhost_driver_callback_register(&vhost_device_ops);
+
+	if (rte_eal_remote_launch(vhost_session, NULL, lcore_id) != 0) {
+		RTE_LOG(ERR, PORT, "Cannot launch the vhost session\n");
+		return -1;
+	}
+
+	vhost_started = 1;
+	return 0;
+}
+
+struct rte_port_vhost *
+rte_port_vhost_create(struct rte_port_vhost_params *conf,
+		      int socket_id,
+		      struct net_port *net_port)
+{
+	struct rte_port_vhost *port;
+	int i;
+
+	port = rte_zmalloc_socket("PORT", sizeof(*port), CACHE_LINE_SIZE,
+				  socket_id);
+	if (port == NULL) {
+		RTE_LOG(ERR, PORT, "Cannot allocate vhost port\n");
+		return NULL;
+	}
+
+	port->rte_port.type = RTE_PORT_TYPE_VHOST;
+	port->rte_port.ops = rte_port_vhost_ops;
+	port->rte_port.mempool = conf->mempool;
+	port->rte_port.rx_mempool = conf->rx_mempool;
+	port->rte_port.rx_lowat = conf->rx_lowat;
+
+	rte_spinlock_lock(&vhost_lock);
+	for (i = 0; i < VHOST_PORT_MAX; i++) {
+		if (vhost_ports[i] == NULL) {
+			vhost_ports[i] = port;
+			break;
+		}
+	}
+	rte_spinlock_unlock(&vhost_lock);
+	if (i == VHOST_PORT_MAX) {
+		RTE_LOG(ERR, PORT, "Too many vhost ports\n");
+		rte_free(port);
+		return NULL;
+	}
+
+	if (stats_port_register(&port->rte_port, conf->name) != 0) {
+		rte_port_vhost_release(port);
+		rte_free(port);
+		return NULL;
+	}
+
+	net_port->rte_port = &port->rte_port;
+
+	return port;
+}
+
+/* unbinds the guest of a port no dispatch round reaches any more; the
+ * rte_port stays for the statistics
+ */
+void
+rte_port_vhost_release(struct rte_port_vhost *port)
+{
+	int i;
+
+	rte_spinlock_lock(&vhost_lock);
+	for (i = 0; i < VHOST_PORT_MAX; i++) {
+		if (vhost_ports[i] == port)
+			vhost_ports[i] = NULL;
+	}
+	port->dev = NULL;
+	rte_spinlock_unlock(&vhost_lock);
+}
+
+static int
+rte_port_vhost_rx_burst(struct rte_port *rte_port,
+			struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_vhost *p;
+	struct rte_port_stats *stats;
+	struct virtio_net *dev;
+	int rx = 0;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_VHOST);
+
+	p = container_of(rte_port, struct rte_port_vhost, rte_port);
+
+	/* the guest transmits on its TX queue */
+	dev = p->dev;
+	if (likely(dev != NULL))
+		rx = rte_vhost_dequeue_burst(dev, VIRTIO_TXQ,
+					     p->rte_port.rx_mempool ? :
+					     p->rte_port.mempool,
+					     pkts, n_pkts);
+
+	stats = rte_port_stats(&p->rte_port);
+	stats->rx_bursts += 1;
+	stats->rx_empty += (rx == 0);
+	stats->rx_packets += rx;
+	stats->rx_bytes += stats_burst_bytes(pkts, rx);
+
+	mbuf_tsc_set_burst(pkts, rx, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_RX, pkts, rx);
+
+	return rx;
+}
+
+/* buffer ownership and responsivity [tx_burst]
+ *   mbuf: the guest gets copies, free all here
+ */
+int
+rte_port_vhost_tx_burst(struct rte_port *rte_port,
+			struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_vhost *p;
+	struct rte_port_stats *stats;
+	struct virtio_net *dev;
+	uint32_t i, n;
+	int tx = 0;
+
+	RTE_VERIFY(rte_port->type == RTE_PORT_TYPE_VHOST);
+
+	p = container_of(rte_port, struct rte_port_vhost, rte_port);
+
+	/* the library only copies the first segment of a frame */
+	for (i = n = 0; i < n_pkts; i++) {
+		if (unlikely(pkts[i]->pkt.nb_segs > 1)) {
+			rte_port_drop(&p->rte_port, DROP_TX_SEGS, 1);
+			rte_pktmbuf_free(pkts[i]);
+			continue;
+		}
+		pkts[n++] = pkts[i];
+	}
+	n_pkts = n;
+
+	stats = rte_port_stats(&p->rte_port);
+	latency_record_burst(rte_port_latency_tx(&p->rte_port),
+			     pkts, n_pkts, rte_rdtsc());
+	capture_burst(&p->rte_port, CAPTURE_TX, pkts, n_pkts);
+
+	/* the guest receives on its RX queue */
+	dev = p->dev;
+	CYCLES_BEGIN(tsc);
+	if (likely(dev != NULL))
+		tx = rte_vhost_enqueue_burst(dev, VIRTIO_RXQ, pkts, n_pkts);
+	CYCLES_END(CYCLES_TX, tsc, tx);
+	stats->tx_packets += tx;
+	stats->tx_bytes += stats_burst_bytes(pkts, tx);
+	trace(TRACE_TX_BURST, 0, p->rte_port.stats_id, tx);
+
+	if (unlikely(tx < n_pkts))
+		rte_port_drop(&p->rte_port, DROP_TX_FULL, n_pkts - tx);
+	for (i = 0; i < n_pkts; i++)
+		rte_pktmbuf_free(pkts[i]);
+
+	return tx;
+}
+
+static struct rte_port_ops rte_port_vhost_ops = {
+	.rx_burst = rte_port_vhost_rx_burst,
+	.tx_burst = rte_port_vhost_tx_burst,
+};
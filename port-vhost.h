@@ -0,0 +1,72 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _PORT_VHOST_H_
+#define _PORT_VHOST_H_
+
+#include <rte_virtio_net.h>
+
+#include "port.h"
+
+/* Character device the guests' QEMU opens, /dev/<name> */
+#define VHOST_DEV_BASENAME	"usvhost"
+
+#define VHOST_PORT_MAX		8
+
+/*
+ * A vhost port exchanges frames with a virtio-net guest through the
+ * vhost library. Guests are bound to the vhost ports in the order they
+ * come up, a port without a guest receives nothing and drops what it
+ * sends. The library copies the frames both ways, so RX mbufs come from
+ * the port's own pool and TX mbufs are freed once copied.
+ */
+struct rte_port_vhost_params {
+	char			*name;
+	struct rte_mempool	*mempool;	/* for lwIP output */
+	struct rte_mempool	*rx_mempool;	/* own RX pool */
+	uint32_t		 rx_lowat;
+};
+
+struct rte_port_vhost {
+	struct virtio_net *volatile	 dev;	/* NULL without a guest */
+	struct rte_port			 rte_port;
+};
+
+struct rte_port_vhost * rte_port_vhost_create
+	(struct rte_port_vhost_params *conf, int socket_id,
+	 struct net_port *net_port);
+int rte_port_vhost_start(void);
+void rte_port_vhost_release(struct rte_port_vhost *port);
+int rte_port_vhost_tx_burst
+	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
+
+#endif
@@ -36,6 +36,8 @@
 #include <stdint.h>
 
 #include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_memory.h>
 
 #include <lwip/ip_addr.h>
 #include <lwip/netif.h>
@@ -43,6 +45,9 @@
 typedef enum {
 	RTE_PORT_TYPE_ETH = 1,
 	RTE_PORT_TYPE_KNI,
+	RTE_PORT_TYPE_RING,
+	RTE_PORT_TYPE_VHOST,
+	RTE_PORT_TYPE_TAP,
 	RTE_PORT_TYPE_PLUG = 90,
 } rte_port_type;
 
@@ -52,31 +57,114 @@ typedef int (*rte_port_op_rx_burst)
 	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
 typedef int (*rte_port_op_tx_burst)
 	(struct rte_port *rte_port, struct rte_mbuf **pkts, uint32_t n_pkts);
+typedef uint32_t (*rte_port_op_rx_pending)(struct rte_port *rte_port);
+/* a descriptor readable once the port has packets, or -1 */
+typedef int (*rte_port_op_rx_fd)(struct rte_port *rte_port);
 
 struct rte_port_ops {
 	rte_port_op_rx_burst	rx_burst;
 	rte_port_op_tx_burst	tx_burst;
+	rte_port_op_rx_pending	rx_pending;	/* optional */
+	rte_port_op_rx_fd	rx_fd;		/* optional */
 };
 
+/* Why a packet was dropped, counted per port in rte_port_stats */
+typedef enum {
+	/* receive path, counted in rx_dropped */
+	DROP_RX_PBUF = 0,	/* pbuf allocation failed */
+	DROP_RX_NO_EGRESS,	/* no other port in the bridge */
+	DROP_RX_LOWAT,		/* RX pool under its low watermark */
+	DROP_RX_TRUNC,		/* frame larger than the RX buffers */
+	/* transmit path, counted in tx_dropped */
+	DROP_TX_MBUF,		/* mbuf allocation failed */
+	DROP_TX_FRAG,		/* fragmentation failed */
+	DROP_TX_CLONE,		/* clone failed while flooding */
+	DROP_TX_FULL,		/* tx_burst did not take all */
+	DROP_TX_LWIP,		/* lwIP input failed */
+	DROP_TX_VXLAN,		/* no VXLAN peer or encapsulation failed */
+	DROP_TX_UDP,		/* UDP send failed */
+	DROP_TX_SEGS,		/* too many segments for the port */
+	DROP_REASON_MAX,
+} drop_reason;
+
+#define DROP_TX_FIRST	DROP_TX_MBUF
+
+/* kept per lcore in stats.h, see rte_port_stats() */
 struct rte_port_stats {
 	uint64_t	rx_packets;
+	uint64_t	rx_bytes;
 	uint64_t	tx_packets;
+	uint64_t	tx_bytes;
 	uint64_t	rx_dropped;
 	uint64_t	tx_dropped;
-};
+	uint64_t	rx_bursts;
+	uint64_t	rx_empty;	/* bursts returning nothing */
+	uint64_t	drops[DROP_REASON_MAX];
+} __rte_cache_aligned;
+
+struct capture_tap;
 
 struct rte_port {
 	rte_port_type		type;
+	uint16_t		stats_id;
 	struct rte_port_ops	ops;
-	struct rte_port_stats	stats;
+	struct capture_tap     *capture;	/* see capture.h */
+	struct rte_mempool     *mempool;	/* on the port's socket */
+	struct rte_mempool     *rx_mempool;	/* own RX pool, if any */
+	uint32_t		rx_lowat;	/* free mbufs, see mempool.h */
 };
 
+/* IP MTU of a port, larger ones need scattered RX or a larger data room */
+#define NET_MTU_DEFAULT	1500
+#define NET_MTU_MIN	68
+#define NET_MTU_MAX	9000
+
+typedef enum {
+	NET_POLL_BUSY = 0,
+	NET_POLL_ADAPTIVE,
+} net_poll_mode;
+
+/* TX distribution over the members of a bonded eth port */
+typedef enum {
+	NET_XMIT_L34 = 0,
+	NET_XMIT_L23,
+	NET_XMIT_L2,
+} net_xmit_policy;
+
+/* Members of a bonded eth port */
+#define NET_MEMBERS_MAX	8
+
 struct net {
 	uint8_t		 port_id;
 	char		*name;
 	ip_addr_t	 ip_addr;
 	ip_addr_t	 netmask;
 	ip_addr_t	 gw;
+	net_poll_mode	 poll_mode;
+	uint32_t	 idle_us;	/* max polling delay when idle */
+	uint32_t	 weight;	/* max bursts per round */
+	uint32_t	 nb_mbuf;	/* of its own RX pool */
+	uint32_t	 lowat_pct;	/* of its RX pool, 0 for the default */
+	uint32_t	 cache_size;	/* of its RX pool */
+	uint16_t	 nb_rx_desc;
+	uint16_t	 nb_tx_desc;
+	uint32_t	 burst;		/* packets per rx_burst */
+	uint16_t	 mtu;
+	uint8_t		 members[NET_MEMBERS_MAX];	/* bonded eth port */
+	uint8_t		 nr_members;
+	net_xmit_policy	 xmit_policy;
+};
+
+struct net_poll {
+	uint32_t	 empty_polls;
+	uint32_t	 backoff_us;
+	uint64_t	 next_tsc;	/* not polled before */
+};
+
+struct net_sched {
+	uint32_t	 credit;	/* bursts in the next round */
+	uint32_t	 skip;		/* rounds left to skip */
+	uint32_t	 idle_rounds;
 };
 
 struct net_port {
@@ -85,6 +173,8 @@ struct net_port {
 	struct netif		*netif;
 	struct bridge_port	*bridge_port;
 	struct rte_port		*rte_port;
+	struct net_poll		 poll;
+	struct net_sched	 sched;
 };
 
 #ifndef container_of
@@ -0,0 +1,130 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rte_cycles.h>
+#include <rte_debug.h>
+#include <rte_malloc.h>
+#include <rte_spinlock.h>
+
+#include "rcu.h"
+
+struct rcu_lcore rcu_lcores[RTE_MAX_LCORE];
+
+static void *deferred[RCU_DEFER_MAX];
+static int nr_deferred;
+static rte_spinlock_t deferred_lock = RTE_SPINLOCK_INITIALIZER;
+
+static int
+rcu_readers_online(void)
+{
+	unsigned lcore_id;
+
+	RTE_LCORE_FOREACH(lcore_id) {
+		if (rcu_lcores[lcore_id].online)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Frees p right away while no dispatch lcore runs, at startup, or
+ * defers it to the next rcu_reclaim() otherwise.
+ */
+void
+rcu_free(void *p)
+{
+	if (p == NULL)
+		return;
+
+	if (!rcu_readers_online()) {
+		rte_free(p);
+		return;
+	}
+
+	rte_spinlock_lock(&deferred_lock);
+	if (nr_deferred >= RCU_DEFER_MAX) {
+		/* leak rather than free under the feet of a reader */
+		rte_spinlock_unlock(&deferred_lock);
+		RTE_LOG(WARNING, APP, "Too many tables waiting for RCU\n");
+		return;
+	}
+	deferred[nr_deferred++] = p;
+	rte_spinlock_unlock(&deferred_lock);
+}
+
+/*
+ * Waits until every online dispatch lcore went through a quiescent state.
+ * Must not be called from a dispatch lcore.
+ */
+void
+rcu_synchronize(void)
+{
+	uint64_t seen[RTE_MAX_LCORE];
+	unsigned lcore_id;
+
+	RTE_VERIFY(!rcu_lcores[rte_lcore_id()].online);
+
+	rte_mb();
+	RTE_LCORE_FOREACH(lcore_id)
+		seen[lcore_id] = rcu_lcores[lcore_id].epoch;
+
+	RTE_LCORE_FOREACH(lcore_id) {
+		while (rcu_lcores[lcore_id].online &&
+		       rcu_lcores[lcore_id].epoch == seen[lcore_id])
+			rte_delay_us(10);
+	}
+}
+
+void
+rcu_reclaim(void)
+{
+	void *p[RCU_DEFER_MAX];
+	int i, n;
+
+	rte_spinlock_lock(&deferred_lock);
+	n = nr_deferred;
+	for (i = 0; i < n; i++)
+		p[i] = deferred[i];
+	nr_deferred = 0;
+	rte_spinlock_unlock(&deferred_lock);
+
+	if (n == 0)
+		return;
+
+	rcu_synchronize();
+	for (i = 0; i < n; i++)
+		rte_free(p[i]);
+}
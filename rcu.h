@@ -0,0 +1,97 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _RCU_H_
+#define _RCU_H_
+
+#include <stdint.h>
+
+#include <rte_atomic.h>
+#include <rte_lcore.h>
+#include <rte_memory.h>
+
+/*
+ * Tables read by the dispatch lcores are never changed in place: a writer
+ * builds a new copy, publishes it with rcu_assign() and hands the old one
+ * to rcu_free(). A dispatch lcore reads each table once per round through
+ * rcu_dereference() and reports a quiescent state at the end of the round,
+ * after which it holds no reference to any table. rcu_reclaim() waits for
+ * every online dispatch lcore to do so before freeing the old copies.
+ *
+ * Writers are serialized by the caller: they run at startup or on the
+ * dispatch lcore, from the commands of the control socket.
+ */
+
+/* Tables freed at once by rcu_reclaim() */
+#define RCU_DEFER_MAX		64
+
+struct rcu_lcore {
+	volatile uint64_t	 epoch;
+	volatile int		 online;
+} __rte_cache_aligned;
+
+extern struct rcu_lcore rcu_lcores[RTE_MAX_LCORE];
+
+#define rcu_assign(p, v)						\
+	do {								\
+		rte_wmb();						\
+		(p) = (v);						\
+	} while (0)
+
+#define rcu_dereference(p)	(*(volatile typeof(p) *)&(p))
+
+static inline void
+rcu_quiescent(void)
+{
+	rte_wmb();
+	rcu_lcores[rte_lcore_id()].epoch++;
+}
+
+static inline void
+rcu_online(void)
+{
+	rcu_lcores[rte_lcore_id()].online = 1;
+	rcu_quiescent();
+}
+
+static inline void
+rcu_offline(void)
+{
+	rcu_quiescent();
+	rcu_lcores[rte_lcore_id()].online = 0;
+}
+
+void rcu_free(void *p);
+void rcu_synchronize(void);
+void rcu_reclaim(void);
+
+#endif
@@ -0,0 +1,381 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+
+#include "capture.h"
+#include "main.h"
+#include "mempool.h"
+#include "replay.h"
+
+/* pcap magic numbers, microsecond and nanosecond timestamps */
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_MAGIC_NSEC		0xa1b23c4d
+
+/* a record or block body, larger ones are rejected */
+#define REPLAY_BLOCK_MAX	(128 * 1024)
+
+struct pcap_hdr {
+	uint16_t	 version_major;
+	uint16_t	 version_minor;
+	int32_t		 thiszone;
+	uint32_t	 sigfigs;
+	uint32_t	 snaplen;
+	uint32_t	 network;
+};
+
+struct pcap_rec {
+	uint32_t	 ts_sec;
+	uint32_t	 ts_frac;	/* usec or nsec */
+	uint32_t	 incl_len;
+	uint32_t	 orig_len;
+};
+
+struct replay_file {
+	FILE		*f;
+	int		 ng;		/* pcapng rather than pcap */
+	int		 swapped;
+	int		 nsec;		/* pcap only, pcapng is in usec */
+	uint8_t		*buf;
+};
+
+static inline uint32_t
+rf32(struct replay_file *rf, uint32_t v)
+{
+	return rf->swapped ? rte_bswap32(v) : v;
+}
+
+static inline uint16_t
+rf16(struct replay_file *rf, uint16_t v)
+{
+	return rf->swapped ? rte_bswap16(v) : v;
+}
+
+static void
+replay_close(struct replay_file *rf)
+{
+	if (rf->f)
+		fclose(rf->f);
+	free(rf->buf);
+	memset(rf, 0, sizeof(*rf));
+}
+
+/* Reads the file header, telling pcap and pcapng apart by the magic */
+static int
+replay_open(struct replay_file *rf, const char *path)
+{
+	struct pcap_hdr hdr;
+	uint32_t magic;
+
+	memset(rf, 0, sizeof(*rf));
+
+	rf->buf = malloc(REPLAY_BLOCK_MAX);
+	rf->f = fopen(path, "r");
+	if (rf->buf == NULL || rf->f == NULL)
+		goto fail;
+
+	if (fread(&magic, sizeof(magic), 1, rf->f) != 1)
+		goto fail;
+
+	if (magic == PCAPNG_SHB) {
+		/* the section header is parsed as any other block */
+		rf->ng = 1;
+		rewind(rf->f);
+		return 0;
+	}
+
+	switch (magic) {
+	case PCAP_MAGIC:
+		break;
+	case PCAP_MAGIC_NSEC:
+		rf->nsec = 1;
+		break;
+	default:
+		rf->swapped = 1;
+		if (magic == rte_bswap32(PCAP_MAGIC_NSEC))
+			rf->nsec = 1;
+		else if (magic != rte_bswap32(PCAP_MAGIC))
+			goto fail;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, rf->f) != 1 ||
+	    rf32(rf, hdr.network) != PCAPNG_LINKTYPE_ETHER)
+		goto fail;
+	return 0;
+
+fail:
+	replay_close(rf);
+	return -1;
+}
+
+static int
+replay_next_pcap(struct replay_file *rf, uint64_t *ns, uint8_t **dat,
+		 uint32_t *len)
+{
+	struct pcap_rec rec;
+
+	if (fread(&rec, sizeof(rec), 1, rf->f) != 1)
+		return 0;
+
+	*len = rf32(rf, rec.incl_len);
+	if (*len > REPLAY_BLOCK_MAX ||
+	    fread(rf->buf, 1, *len, rf->f) != *len)
+		return -1;
+
+	*ns = (uint64_t)rf32(rf, rec.ts_sec) * 1000000000 +
+		(uint64_t)rf32(rf, rec.ts_frac) * (rf->nsec ? 1 : 1000);
+	*dat = rf->buf;
+	return 1;
+}
+
+/* Looks for the epb_flags option of an enhanced packet from off */
+static int
+pcapng_outbound(struct replay_file *rf, uint32_t off, uint32_t end)
+{
+	uint16_t *opt, code, len;
+
+	for (; off + 4 <= end; off += 4 + ((len + 3) & ~3)) {
+		opt = (uint16_t *)(rf->buf + off);
+		code = rf16(rf, opt[0]);
+		len = rf16(rf, opt[1]);
+
+		if (code == PCAPNG_OPT_END)
+			break;
+		if (code == PCAPNG_OPT_EPB_FLAGS && len == 4 &&
+		    off + 8 <= end)
+			return (rf32(rf, *(uint32_t *)(opt + 2)) & 3) ==
+				PCAPNG_EPB_OUTBOUND;
+	}
+	return 0;
+}
+
+/* Enhanced packets only, the outbound ones of our own captures skipped */
+static int
+replay_next_pcapng(struct replay_file *rf, uint64_t *ns, uint8_t **dat,
+		   uint32_t *len)
+{
+	uint32_t hdr[2], type, total, off, end, *epb;
+
+	for (;;) {
+		if (fread(hdr, sizeof(hdr), 1, rf->f) != 1)
+			return 0;
+
+		type = hdr[0];
+		if (type == PCAPNG_SHB) {
+			/* each section sets its own byte order */
+			if (fread(rf->buf, 4, 1, rf->f) != 1)
+				return -1;
+			rf->swapped = *(uint32_t *)rf->buf != PCAPNG_MAGIC;
+			total = rf32(rf, hdr[1]);
+			if (total < 16 || total - 12 > REPLAY_BLOCK_MAX ||
+			    fread(rf->buf, 1, total - 12, rf->f) != total - 12)
+				return -1;
+			continue;
+		}
+
+		type = rf32(rf, type);
+		total = rf32(rf, hdr[1]);
+		if (total < 12 || total - 8 > REPLAY_BLOCK_MAX ||
+		    fread(rf->buf, 1, total - 8, rf->f) != total - 8)
+			return -1;
+		end = total - 12;	/* body without the trailing length */
+
+		if (type == PCAPNG_IDB) {
+			if (rf16(rf, *(uint16_t *)rf->buf) !=
+			    PCAPNG_LINKTYPE_ETHER)
+				return -1;
+			continue;
+		}
+		if (type != PCAPNG_EPB || end < 20)
+			continue;
+
+		epb = (uint32_t *)rf->buf;
+		*len = rf32(rf, epb[3]);
+		off = 20 + ((*len + 3) & ~3);
+		if (off > end)
+			return -1;
+		if (pcapng_outbound(rf, off, end))
+			continue;
+
+		*ns = (((uint64_t)rf32(rf, epb[1]) << 32) |
+		       rf32(rf, epb[2])) * 1000;
+		*dat = rf->buf + 20;
+		return 1;
+	}
+}
+
+static int
+replay_next(struct replay_file *rf, uint64_t *ns, uint8_t **dat,
+	    uint32_t *len)
+{
+	if (rf->ng)
+		return replay_next_pcapng(rf, ns, dat, len);
+	return replay_next_pcap(rf, ns, dat, len);
+}
+
+/*
+ * Preloads every frame of a pcap or pcapng file into a hugepage frame
+ * store, in two passes: one to size the store and one to fill it. The
+ * timestamps are turned into TSC offsets scaled by speed, in percent.
+ * Frames larger than an mbuf are skipped.
+ */
+int
+replay_load(struct replay *r, const char *path, uint32_t speed,
+	    int socket_id)
+{
+	struct replay_file rf;
+	struct replay_frame *frame;
+	uint64_t ns, base = 0, bytes = 0, tsc = 0;
+	uint32_t len, nr = 0, skipped = 0, i;
+	double scale;
+	uint8_t *dat;
+	int ret;
+
+	memset(r, 0, sizeof(*r));
+	r->speed = speed;
+
+	if (replay_open(&rf, path) != 0) {
+		RTE_LOG(ERR, APP, "Cannot open capture %s\n", path);
+		return -1;
+	}
+	while ((ret = replay_next(&rf, &ns, &dat, &len)) > 0) {
+		if (len > mempool_conf.data_room) {
+			skipped++;
+			continue;
+		}
+		nr++;
+		bytes += len;
+	}
+	replay_close(&rf);
+	if (ret < 0 || nr == 0) {
+		RTE_LOG(ERR, APP, "No frame to replay in %s\n", path);
+		return -1;
+	}
+
+	r->frames = rte_zmalloc_socket("REPLAY", sizeof(*frame) * nr,
+				       CACHE_LINE_SIZE, socket_id);
+	r->data = rte_malloc_socket("REPLAY", bytes, CACHE_LINE_SIZE,
+				    socket_id);
+	if (r->frames == NULL || r->data == NULL) {
+		RTE_LOG(ERR, APP, "Cannot allocate %"PRIu64" bytes to "
+			"replay\n", bytes);
+		return -1;
+	}
+
+	scale = speed ? (double)rte_get_tsc_hz() / 1e9 *
+		REPLAY_SPEED_ORIGINAL / speed : 0;
+
+	if (replay_open(&rf, path) != 0)
+		return -1;
+	for (i = 0, bytes = 0; i < nr &&
+	     replay_next(&rf, &ns, &dat, &len) > 0;) {
+		if (len > mempool_conf.data_room)
+			continue;
+		if (i == 0)
+			base = ns;
+
+		/* out of order timestamps are sent right away */
+		if (ns > base)
+			tsc = RTE_MAX(tsc, (uint64_t)((ns - base) * scale));
+
+		frame = &r->frames[i++];
+		frame->tsc = tsc;
+		frame->off = bytes;
+		frame->len = len;
+		rte_memcpy(r->data + bytes, dat, len);
+		bytes += len;
+	}
+	replay_close(&rf);
+
+	r->nr_frames = i;
+	/* the next pass starts one mean inter-arrival after the last frame */
+	r->span = i > 1 ? tsc + tsc / (i - 1) : 0;
+
+	RTE_LOG(INFO, APP, "Loaded %u frames from %s, skipped %u\n",
+		r->nr_frames, path, skipped);
+	return 0;
+}
+
+/*
+ * Copies the frames due by now into newly allocated mbufs, looping over
+ * the capture. At maximum rate, every frame is due.
+ */
+uint32_t
+replay_burst(struct replay *r, struct rte_mempool *mp,
+	     struct rte_mbuf **pkts, uint32_t n_pkts, uint64_t now)
+{
+	struct replay_frame *frame;
+	struct rte_mbuf *m;
+	uint32_t i;
+
+	if (r->start == 0)
+		r->start = now;
+
+	for (i = 0; i < n_pkts; i++) {
+		frame = &r->frames[r->next];
+		if (r->speed != REPLAY_SPEED_MAX_RATE &&
+		    r->start + frame->tsc > now)
+			break;
+
+		m = rte_pktmbuf_alloc(mp);
+		if (m == NULL)
+			break;
+
+		rte_memcpy(rte_pktmbuf_mtod(m, void *),
+			   r->data + frame->off, frame->len);
+		m->pkt.data_len = frame->len;
+		m->pkt.pkt_len = frame->len;
+		pkts[i] = m;
+		r->bytes += frame->len;
+
+		if (++r->next >= r->nr_frames) {
+			r->next = 0;
+			r->start += r->span;
+		}
+	}
+
+	r->pkts += i;
+
+	return i;
+}
@@ -0,0 +1,68 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdint.h>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+/* Pace of the replay, in percent of the original one */
+#define REPLAY_SPEED_MAX_RATE	0
+#define REPLAY_SPEED_ORIGINAL	100
+
+struct replay_frame {
+	uint64_t		 tsc;	/* since the first frame, scaled */
+	uint32_t		 off;	/* in the frame store */
+	uint16_t		 len;
+};
+
+struct replay {
+	uint8_t			*data;		/* frame store, in hugepages */
+	struct replay_frame	*frames;
+	uint32_t		 nr_frames;
+	uint32_t		 speed;
+	uint32_t		 next;
+	uint64_t		 start;		/* tsc of this pass */
+	uint64_t		 span;		/* tsc of a whole pass */
+	uint64_t		 pkts;
+	uint64_t		 bytes;
+};
+
+int replay_load(struct replay *r, const char *path, uint32_t speed,
+		int socket_id);
+uint32_t replay_burst(struct replay *r, struct rte_mempool *mp,
+		      struct rte_mbuf **pkts, uint32_t n_pkts, uint64_t now);
+
+#endif
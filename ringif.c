@@ -0,0 +1,163 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <lwip/mem.h>
+#include <lwip/netif.h>
+#include <netif/etharp.h>
+
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+
+#include "convert.h"
+#include "ipfrag.h"
+#include "ringif.h"
+#include "stats.h"
+
+struct ringif *
+ringif_alloc(int socket_id)
+{
+	struct ringif *ringif;
+
+	ringif = rte_zmalloc_socket("RINGIF", sizeof(*ringif),
+				    CACHE_LINE_SIZE, socket_id);
+	return ringif;
+}
+
+err_t
+ringif_init(struct ringif *ringif, struct rte_port_ring_params *params,
+	    int socket_id, struct net_port *net_port)
+{
+	ringif->rte_port_type = RTE_PORT_TYPE_RING;
+
+	ringif->ring_port = rte_port_ring_create(params, socket_id, net_port);
+	if (!ringif->ring_port)
+		return ERR_MEM;
+
+	memset(&ringif->netif, 0, sizeof(ringif->netif));
+	ringif->netif.state = ringif;
+
+	net_port->netif = &ringif->netif;
+	RTE_VERIFY(net_port->rte_port == &ringif->ring_port->rte_port);
+
+	return ERR_OK;
+}
+
+/* buffer ownership and responsivity [if_input]
+ *   pbuf: transfer the ownership of a newly allocated pbuf to lwip
+ *   mbuf: free all here
+ */
+err_t
+ringif_input(struct ringif *ringif, struct rte_mbuf *m)
+{
+	struct pbuf *p;
+	err_t err;
+
+	RTE_VERIFY(ringif->rte_port_type == RTE_PORT_TYPE_RING);
+
+	latency_record(rte_port_latency_local(&ringif->ring_port->rte_port),
+		       m, rte_rdtsc());
+
+	CYCLES_BEGIN(tsc);
+	p = mbuf_to_pbuf(m);
+	rte_pktmbuf_free(m);
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
+	if (p == 0) {
+		rte_port_drop(&ringif->ring_port->rte_port, DROP_RX_PBUF, 1);
+		return ERR_OK;
+	}
+
+	CYCLES_BEGIN(lwip_tsc);
+	err = ringif->netif.input(p, &ringif->netif);
+	CYCLES_END(CYCLES_LWIP, lwip_tsc, 1);
+
+	return err;
+}
+
+/* buffer ownership and responsivity [if_output]
+ *   pbuf: return all to the caller in lwip
+ *   mbuf: transfer the ownership of a newly allocated mbuf to
+ *         the underlying port
+ */
+static err_t
+low_level_output(struct netif *netif, struct pbuf *p)
+{
+	struct ringif *ringif = (struct ringif *)netif->state;
+	struct rte_port_ring *ring_port;
+	struct rte_mbuf *m, *frags[IPFRAG_MAX_FRAGS];
+	int n;
+
+	RTE_VERIFY(ringif->rte_port_type == RTE_PORT_TYPE_RING);
+
+	ring_port = ringif->ring_port;
+
+	CYCLES_BEGIN(tsc);
+	m = pbuf_to_mbuf(p, ring_port->rte_port.mempool);
+	if (m == NULL) {
+		rte_port_drop(&ring_port->rte_port, DROP_TX_MBUF, 1);
+		return ERR_MEM;
+	}
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
+
+	n = ipfrag_fragment(m, netif->mtu, frags, IPFRAG_MAX_FRAGS);
+	if (n < 0) {
+		rte_port_drop(&ring_port->rte_port, DROP_TX_FRAG, 1);
+		return ERR_MEM;
+	}
+
+	rte_port_ring_tx_burst(&ring_port->rte_port, frags, n);
+
+	return ERR_OK;
+}
+
+err_t
+ringif_added_cb(struct netif *netif)
+{
+	struct ringif *ringif = (struct ringif *)netif->state;
+
+	RTE_VERIFY(ringif->rte_port_type == RTE_PORT_TYPE_RING);
+
+	netif->name[0] = 'r';
+	netif->name[1] = 'i';
+	netif->output = etharp_output;
+	netif->linkoutput = low_level_output;
+	netif->mtu = 1500;
+	eth_random_addr(netif->hwaddr);
+	netif->hwaddr_len = 6;
+	netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
+	return ERR_OK;
+}
@@ -0,0 +1,211 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rte_malloc.h>
+
+#include "rcu.h"
+#include "route.h"
+
+static struct route_table *route_table;
+
+static struct route_table *
+route_table_copy(void)
+{
+	struct route_table *table;
+
+	table = rte_zmalloc("ROUTE", sizeof(*table), CACHE_LINE_SIZE);
+	if (table == NULL) {
+		RTE_LOG(ERR, APP, "Cannot allocate route table\n");
+		return NULL;
+	}
+	if (route_table)
+		*table = *route_table;
+	return table;
+}
+
+static void
+route_publish(struct route_table *table)
+{
+	rcu_free(route_table);
+	rcu_assign(route_table, table);
+}
+
+static int
+route_prefix_len(ip_addr_t *netmask)
+{
+	return __builtin_popcount(netmask->addr);
+}
+
+int
+route_add(ip_addr_t *dst, ip_addr_t *netmask, struct netif *netif)
+{
+	struct route_table *table;
+	struct route route;
+	int i, len;
+
+	if (route_table && route_table->nr_routes >= ROUTE_MAX)
+		return -1;
+
+	route.dst.addr = dst->addr & netmask->addr;
+	route.netmask = *netmask;
+	route.netif = netif;
+	len = route_prefix_len(netmask);
+
+	table = route_table_copy();
+	if (table == NULL)
+		return -1;
+
+	for (i = 0; i < table->nr_routes; i++) {
+		if (ip_addr_cmp(&table->routes[i].dst, &route.dst) &&
+		    ip_addr_cmp(&table->routes[i].netmask, netmask)) {
+			rte_free(table);
+			return -1;
+		}
+		if (route_prefix_len(&table->routes[i].netmask) < len)
+			break;
+	}
+	memmove(&table->routes[i + 1], &table->routes[i],
+		(table->nr_routes - i) * sizeof(route));
+	table->routes[i] = route;
+	table->nr_routes++;
+
+	route_publish(table);
+	return 0;
+}
+
+int
+route_del(ip_addr_t *dst, ip_addr_t *netmask)
+{
+	struct route_table *table;
+	struct route *r;
+	int i, n = 0;
+
+	table = route_table_copy();
+	if (table == NULL)
+		return -1;
+
+	for (i = 0; i < table->nr_routes; i++) {
+		r = &table->routes[i];
+		if (r->dst.addr == (dst->addr & netmask->addr) &&
+		    ip_addr_cmp(&r->netmask, netmask))
+			continue;
+		table->routes[n++] = *r;
+	}
+	if (n == table->nr_routes) {
+		rte_free(table);
+		return -1;
+	}
+	table->nr_routes = n;
+
+	route_publish(table);
+	return 0;
+}
+
+/* drops the routes through a netif about to be removed */
+int
+route_del_netif(struct netif *netif)
+{
+	struct route_table *table;
+	int i, n = 0;
+
+	if (route_table == NULL)
+		return 0;
+
+	table = route_table_copy();
+	if (table == NULL)
+		return -1;
+
+	for (i = 0; i < table->nr_routes; i++) {
+		if (table->routes[i].netif != netif)
+			table->routes[n++] = table->routes[i];
+	}
+	if (n == table->nr_routes) {
+		rte_free(table);
+		return 0;
+	}
+	table->nr_routes = n;
+
+	route_publish(table);
+	return 0;
+}
+
+/* the longest prefix of an up netif whose subnet holds dest, or -1 */
+static int
+route_connected_len(ip_addr_t *dest)
+{
+	struct netif *netif;
+	int len, best = -1;
+
+	for (netif = netif_list; netif != NULL; netif = netif->next) {
+		if (!netif_is_up(netif) ||
+		    !ip_addr_netcmp(dest, &netif->ip_addr, &netif->netmask))
+			continue;
+		len = route_prefix_len(&netif->netmask);
+		if (len > best)
+			best = len;
+	}
+	return best;
+}
+
+/*
+ * lwIP calls the hook before it walks its netifs, so a route is only
+ * returned when its prefix is longer than the one of the directly
+ * connected subnet of dest, if any.
+ */
+struct netif *
+route_lookup(ip_addr_t *dest)
+{
+	struct route_table *table = rcu_dereference(route_table);
+	struct route *r;
+	int i;
+
+	if (table == NULL)
+		return NULL;
+
+	for (i = 0; i < table->nr_routes; i++) {
+		r = &table->routes[i];
+		if (ip_addr_netcmp(dest, &r->dst, &r->netmask) &&
+		    netif_is_up(r->netif)) {
+			if (route_prefix_len(&r->netmask) <=
+			    route_connected_len(dest))
+				return NULL;
+			return r->netif;
+		}
+	}
+	return NULL;
+}
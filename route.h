@@ -0,0 +1,64 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _ROUTE_H_
+#define _ROUTE_H_
+
+#include <lwip/ip_addr.h>
+#include <lwip/netif.h>
+
+#define ROUTE_MAX		64
+
+/*
+ * Static routes looked up by lwIP through LWIP_HOOK_IP4_ROUTE before its
+ * own netif subnets. A route wins over a directly connected subnet only
+ * with a longer prefix. A route only picks the netif, the next hop is
+ * still the gateway of that netif.
+ */
+struct route {
+	ip_addr_t	 dst;
+	ip_addr_t	 netmask;
+	struct netif	*netif;
+};
+
+/* longest prefix first, replaced as a whole, see rcu.h */
+struct route_table {
+	int		 nr_routes;
+	struct route	 routes[ROUTE_MAX];
+};
+
+int route_add(ip_addr_t *dst, ip_addr_t *netmask, struct netif *netif);
+int route_del(ip_addr_t *dst, ip_addr_t *netmask);
+int route_del_netif(struct netif *netif);
+struct netif * route_lookup(ip_addr_t *dest);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <rte_cycles.h>
+#include <rte_memzone.h>
+
+#include "main.h"
+#include "stats.h"
+
+struct stats_shm *stats_shm;
+
+/* ports of the primary process, by stats id */
+static struct rte_port *stats_ports[STATS_PORT_MAX];
+
+const char *drop_reason_names[DROP_REASON_MAX] = {
+	[DROP_RX_PBUF]	    = "rx_pbuf",
+	[DROP_RX_NO_EGRESS] = "rx_no_egress",
+	[DROP_RX_LOWAT]	    = "rx_lowat",
+	[DROP_RX_TRUNC]	    = "rx_trunc",
+	[DROP_TX_MBUF]	    = "tx_mbuf",
+	[DROP_TX_FRAG]	    = "tx_frag",
+	[DROP_TX_CLONE]	    = "tx_clone",
+	[DROP_TX_FULL]	    = "tx_full",
+	[DROP_TX_LWIP]	    = "tx_lwip",
+	[DROP_TX_VXLAN]	    = "tx_vxlan",
+	[DROP_TX_UDP]	    = "tx_udp",
+	[DROP_TX_SEGS]	    = "tx_segs",
+};
+
+const char *cycles_stage_names[CYCLES_STAGE_MAX] = {
+	[CYCLES_RX]	 = "rx",
+	[CYCLES_CONVERT] = "convert",
+	[CYCLES_LWIP]	 = "lwip",
+	[CYCLES_BRIDGE]	 = "bridge",
+	[CYCLES_VXLAN]	 = "vxlan",
+	[CYCLES_TX]	 = "tx",
+};
+
+int
+stats_init(int socket_id)
+{
+	const struct rte_memzone *mz;
+
+	mz = rte_memzone_reserve(STATS_MZ_NAME, sizeof(*stats_shm),
+				 socket_id, 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, APP, "Cannot reserve stats memzone\n");
+		return -1;
+	}
+
+	stats_shm = mz->addr;
+	memset(stats_shm, 0, sizeof(*stats_shm));
+	stats_shm->hz = rte_get_tsc_hz();
+
+	return 0;
+}
+
+/*
+ * Maps the statistics of the primary process, read only from the
+ * secondary process.
+ */
+int
+stats_attach(void)
+{
+	const struct rte_memzone *mz;
+
+	mz = rte_memzone_lookup(STATS_MZ_NAME);
+	if (mz == NULL) {
+		RTE_LOG(ERR, APP, "Cannot find stats memzone\n");
+		return -1;
+	}
+
+	stats_shm = mz->addr;
+
+	return 0;
+}
+
+int
+stats_port_register(struct rte_port *rte_port, const char *name)
+{
+	struct stats_port_info *info;
+	uint32_t id;
+
+	/* a port added again keeps its counters */
+	for (id = 0; id < stats_shm->nr_ports; id++) {
+		if (!strcmp(stats_shm->info[id].name, name)) {
+			rte_port->stats_id = id;
+			stats_ports[id] = rte_port;
+			return 0;
+		}
+	}
+
+	if (id >= STATS_PORT_MAX) {
+		RTE_LOG(ERR, APP, "Too many ports for stats\n");
+		return -1;
+	}
+
+	info = &stats_shm->info[id];
+	snprintf(info->name, sizeof(info->name), "%s", name);
+	info->type = rte_port->type;
+
+	rte_port->stats_id = id;
+	stats_ports[id] = rte_port;
+
+	/* publish the port after its info */
+	rte_wmb();
+	stats_shm->nr_ports = id + 1;
+
+	return 0;
+}
+
+struct rte_port *
+stats_port_lookup(const char *name)
+{
+	uint32_t id;
+
+	for (id = 0; id < stats_shm->nr_ports; id++) {
+		if (!strcmp(stats_shm->info[id].name, name))
+			return stats_ports[id];
+	}
+	return NULL;
+}
+
+void
+stats_port_sum(uint16_t id, struct rte_port_stats *sum)
+{
+	struct rte_port_stats *s;
+	unsigned lcore;
+	int r;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		s = &stats_shm->lcore[lcore].port[id];
+
+		sum->rx_packets  += s->rx_packets;
+		sum->rx_bytes    += s->rx_bytes;
+		sum->tx_packets  += s->tx_packets;
+		sum->tx_bytes    += s->tx_bytes;
+		sum->rx_dropped  += s->rx_dropped;
+		sum->tx_dropped  += s->tx_dropped;
+		sum->rx_bursts   += s->rx_bursts;
+		sum->rx_empty    += s->rx_empty;
+		for (r = 0; r < DROP_REASON_MAX; r++)
+			sum->drops[r] += s->drops[r];
+	}
+}
+
+void
+stats_cycles_sum(cycles_stage stage, struct cycles_stats *sum)
+{
+	struct cycles_stats *c;
+	unsigned lcore;
+
+	memset(sum, 0, sizeof(*sum));
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		c = &stats_shm->lcore[lcore].cycles[stage];
+
+		sum->cycles += c->cycles;
+		sum->calls  += c->calls;
+		sum->pkts   += c->pkts;
+	}
+}
+
+static void
+stats_dump_cycles(FILE *f)
+{
+	struct cycles_stats *c;
+	unsigned lcore;
+	int stage, header = 0;
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		for (stage = 0; stage < CYCLES_STAGE_MAX; stage++) {
+			c = &stats_shm->lcore[lcore].cycles[stage];
+			if (c->calls == 0)
+				continue;
+
+			if (!header) {
+				fprintf(f, "\n%-6s %-8s %16s %14s %14s"
+					" %12s %12s\n",
+					"lcore", "stage", "cycles", "calls",
+					"pkts", "cyc/burst", "cyc/pkt");
+				header = 1;
+			}
+
+			fprintf(f, "%-6u %-8s %16"PRIu64" %14"PRIu64
+				" %14"PRIu64" %12"PRIu64" %12"PRIu64"\n",
+				lcore, cycles_stage_names[stage],
+				c->cycles, c->calls, c->pkts,
+				c->cycles / c->calls,
+				c->pkts ? c->cycles / c->pkts : 0);
+		}
+	}
+}
+
+/* upper bound in microseconds of the bucket holding the given quantile */
+static double
+latency_quantile(struct latency_hist *hist, uint64_t total, double q)
+{
+	uint64_t n = 0, rank = (uint64_t)(total * q);
+	int b;
+
+	for (b = 0; b < LATENCY_BUCKETS - 1; b++) {
+		n += hist->buckets[b];
+		if (n > rank)
+			break;
+	}
+	return (double)(2ULL << b) * 1e6 / stats_shm->hz;
+}
+
+static void
+stats_dump_hist(FILE *f, const char *name, const char *kind,
+		struct latency_hist *hist)
+{
+	uint64_t total = 0;
+	int b;
+
+	for (b = 0; b < LATENCY_BUCKETS; b++)
+		total += hist->buckets[b];
+	if (total == 0)
+		return;
+
+	fprintf(f, "%-16s %-6s %14"PRIu64" %10.1f %10.1f %10.1f\n",
+		name, kind, total,
+		latency_quantile(hist, total, 0.5),
+		latency_quantile(hist, total, 0.99),
+		latency_quantile(hist, total, 0.999));
+}
+
+static void
+stats_dump_latency(FILE *f, uint32_t nr_ports)
+{
+	struct latency_hist tx, local;
+	uint32_t id;
+	unsigned lcore;
+	int b;
+
+	fprintf(f, "\n%-16s %-6s %14s %10s %10s %10s\n",
+		"port", "path", "samples", "p50_us", "p99_us", "p999_us");
+
+	for (id = 0; id < nr_ports; id++) {
+		memset(&tx, 0, sizeof(tx));
+		memset(&local, 0, sizeof(local));
+
+		for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+			for (b = 0; b < LATENCY_BUCKETS; b++) {
+				tx.buckets[b] += stats_shm->lcore[lcore].
+					latency_tx[id].buckets[b];
+				local.buckets[b] += stats_shm->lcore[lcore].
+					latency_local[id].buckets[b];
+			}
+		}
+
+		stats_dump_hist(f, stats_shm->info[id].name, "tx", &tx);
+		stats_dump_hist(f, stats_shm->info[id].name, "local", &local);
+	}
+}
+
+void
+stats_dump(FILE *f)
+{
+	struct rte_port_stats sum;
+	uint32_t id, nr_ports = stats_shm->nr_ports;
+	int r, header = 0;
+
+	rte_rmb();
+
+	fprintf(f, "%-16s %14s %14s %14s %14s %10s %10s %14s %14s\n",
+		"port", "rx_packets", "rx_bytes", "tx_packets", "tx_bytes",
+		"rx_dropped", "tx_dropped", "rx_bursts", "rx_empty");
+
+	for (id = 0; id < nr_ports; id++) {
+		stats_port_sum(id, &sum);
+
+		fprintf(f, "%-16s %14"PRIu64" %14"PRIu64" %14"PRIu64
+			" %14"PRIu64" %10"PRIu64" %10"PRIu64" %14"PRIu64
+			" %14"PRIu64"\n",
+			stats_shm->info[id].name,
+			sum.rx_packets, sum.rx_bytes,
+			sum.tx_packets, sum.tx_bytes,
+			sum.rx_dropped, sum.tx_dropped,
+			sum.rx_bursts, sum.rx_empty);
+	}
+
+	for (id = 0; id < nr_ports; id++) {
+		stats_port_sum(id, &sum);
+
+		for (r = 0; r < DROP_REASON_MAX; r++) {
+			if (sum.drops[r] == 0)
+				continue;
+			if (!header) {
+				fprintf(f, "\n%-16s %-14s %14s\n",
+					"port", "drop", "packets");
+				header = 1;
+			}
+			fprintf(f, "%-16s %-14s %14"PRIu64"\n",
+				stats_shm->info[id].name,
+				drop_reason_names[r], sum.drops[r]);
+		}
+	}
+
+	stats_dump_latency(f, nr_ports);
+	stats_dump_cycles(f);
+	fflush(f);
+}
@@ -0,0 +1,143 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <rte_lcore.h>
+#include <rte_memory.h>
+
+#include "cycles.h"
+#include "latency.h"
+#include "port.h"
+#include "trace.h"
+
+/* Shared with secondary processes reading the statistics */
+#define STATS_MZ_NAME		"lwip_dpdk_stats"
+
+#define STATS_PORT_MAX		16
+#define STATS_NAME_SZ		32
+
+struct stats_port_info {
+	char			 name[STATS_NAME_SZ];
+	rte_port_type		 type;
+};
+
+/* written by its own lcore only */
+struct stats_lcore {
+	struct rte_port_stats	 port[STATS_PORT_MAX];
+	struct cycles_stats	 cycles[CYCLES_STAGE_MAX];
+	struct latency_hist	 latency_tx[STATS_PORT_MAX];	/* forwarded */
+	struct latency_hist	 latency_local[STATS_PORT_MAX]; /* into lwIP */
+} __rte_cache_aligned;
+
+struct stats_shm {
+	uint32_t		 nr_ports;
+	uint64_t		 hz;
+	struct stats_port_info	 info[STATS_PORT_MAX];
+	struct stats_lcore	 lcore[RTE_MAX_LCORE];
+};
+
+extern struct stats_shm *stats_shm;
+extern const char *drop_reason_names[DROP_REASON_MAX];
+
+static inline struct rte_port_stats *
+rte_port_stats(struct rte_port *rte_port)
+{
+	return &stats_shm->lcore[rte_lcore_id()].port[rte_port->stats_id];
+}
+
+static inline void
+rte_port_drop(struct rte_port *rte_port, drop_reason reason, uint32_t n)
+{
+	struct rte_port_stats *stats = rte_port_stats(rte_port);
+
+	if (n == 0)
+		return;
+
+	stats->drops[reason] += n;
+	if (reason < DROP_TX_FIRST)
+		stats->rx_dropped += n;
+	else
+		stats->tx_dropped += n;
+
+	trace(TRACE_DROP, reason, rte_port->stats_id, n);
+}
+
+static inline struct latency_hist *
+rte_port_latency_tx(struct rte_port *rte_port)
+{
+	return &stats_shm->lcore[rte_lcore_id()].latency_tx[rte_port->stats_id];
+}
+
+static inline struct latency_hist *
+rte_port_latency_local(struct rte_port *rte_port)
+{
+	return &stats_shm->lcore[rte_lcore_id()].
+		latency_local[rte_port->stats_id];
+}
+
+static inline void
+cycles_add(cycles_stage stage, uint64_t begin, uint32_t n_pkts)
+{
+	struct cycles_stats *c;
+
+	c = &stats_shm->lcore[rte_lcore_id()].cycles[stage];
+
+	c->cycles += rte_rdtsc() - begin;
+	c->calls += 1;
+	c->pkts += n_pkts;
+}
+
+static inline uint64_t
+stats_burst_bytes(struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	uint64_t bytes = 0;
+	uint32_t i;
+
+	for (i = 0; i < n_pkts; i++)
+		bytes += pkts[i]->pkt.pkt_len;
+	return bytes;
+}
+
+int stats_init(int socket_id);
+int stats_attach(void);
+int stats_port_register(struct rte_port *rte_port, const char *name);
+struct rte_port *stats_port_lookup(const char *name);
+void stats_port_sum(uint16_t id, struct rte_port_stats *sum);
+void stats_cycles_sum(cycles_stage stage, struct cycles_stats *sum);
+void stats_dump(FILE *f);
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <lwip/mem.h>
+#include <lwip/netif.h>
+#include <netif/etharp.h>
+
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+
+#include "convert.h"
+#include "ipfrag.h"
+#include "tapif.h"
+#include "stats.h"
+
+struct tapif *
+tapif_alloc(int socket_id)
+{
+	struct tapif *tapif;
+
+	tapif = rte_zmalloc_socket("TAPIF", sizeof(*tapif),
+				   CACHE_LINE_SIZE, socket_id);
+	return tapif;
+}
+
+err_t
+tapif_init(struct tapif *tapif, struct rte_port_tap_params *params,
+	   int socket_id, struct net_port *net_port)
+{
+	tapif->rte_port_type = RTE_PORT_TYPE_TAP;
+
+	tapif->tap_port = rte_port_tap_create(params, socket_id, net_port);
+	if (!tapif->tap_port)
+		return ERR_MEM;
+
+	memset(&tapif->netif, 0, sizeof(tapif->netif));
+	tapif->netif.state = tapif;
+
+	net_port->netif = &tapif->netif;
+	RTE_VERIFY(net_port->rte_port == &tapif->tap_port->rte_port);
+
+	return ERR_OK;
+}
+
+/* buffer ownership and responsivity [if_input]
+ *   pbuf: transfer the ownership of a newly allocated pbuf to lwip
+ *   mbuf: free all here
+ */
+err_t
+tapif_input(struct tapif *tapif, struct rte_mbuf *m)
+{
+	struct pbuf *p;
+	err_t err;
+
+	RTE_VERIFY(tapif->rte_port_type == RTE_PORT_TYPE_TAP);
+
+	latency_record(rte_port_latency_local(&tapif->tap_port->rte_port),
+		       m, rte_rdtsc());
+
+	CYCLES_BEGIN(tsc);
+	p = mbuf_to_pbuf(m);
+	rte_pktmbuf_free(m);
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
+	if (p == 0) {
+		rte_port_drop(&tapif->tap_port->rte_port, DROP_RX_PBUF, 1);
+		return ERR_OK;
+	}
+
+	CYCLES_BEGIN(lwip_tsc);
+	err = tapif->netif.input(p, &tapif->netif);
+	CYCLES_END(CYCLES_LWIP, lwip_tsc, 1);
+
+	return err;
+}
+
+/* buffer ownership and responsivity [if_output]
+ *   pbuf: return all to the caller in lwip
+ *   mbuf: transfer the ownership of a newly allocated mbuf to
+ *         the underlying port
+ */
+static err_t
+low_level_output(struct netif *netif, struct pbuf *p)
+{
+	struct tapif *tapif = (struct tapif *)netif->state;
+	struct rte_port_tap *tap_port;
+	struct rte_mbuf *m, *frags[IPFRAG_MAX_FRAGS];
+	int n;
+
+	RTE_VERIFY(tapif->rte_port_type == RTE_PORT_TYPE_TAP);
+
+	tap_port = tapif->tap_port;
+
+	CYCLES_BEGIN(tsc);
+	m = pbuf_to_mbuf(p, tap_port->rte_port.mempool);
+	if (m == NULL) {
+		rte_port_drop(&tap_port->rte_port, DROP_TX_MBUF, 1);
+		return ERR_MEM;
+	}
+	CYCLES_END(CYCLES_CONVERT, tsc, 1);
+
+	n = ipfrag_fragment(m, netif->mtu, frags, IPFRAG_MAX_FRAGS);
+	if (n < 0) {
+		rte_port_drop(&tap_port->rte_port, DROP_TX_FRAG, 1);
+		return ERR_MEM;
+	}
+
+	rte_port_tap_tx_burst(&tap_port->rte_port, frags, n);
+
+	return ERR_OK;
+}
+
+err_t
+tapif_added_cb(struct netif *netif)
+{
+	struct tapif *tapif = (struct tapif *)netif->state;
+
+	RTE_VERIFY(tapif->rte_port_type == RTE_PORT_TYPE_TAP);
+
+	netif->name[0] = 't';
+	netif->name[1] = 'p';
+	netif->output = etharp_output;
+	netif->linkoutput = low_level_output;
+	netif->mtu = 1500;
+	eth_random_addr(netif->hwaddr);
+	netif->hwaddr_len = 6;
+	netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
+	return ERR_OK;
+}
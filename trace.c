@@ -0,0 +1,189 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#define _GNU_SOURCE
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rte_memzone.h>
+
+#include "main.h"
+#include "trace.h"
+
+struct trace_shm *trace_shm;
+
+static sem_t trace_dump_sem;
+
+static const char *trace_type_names[TRACE_TYPE_MAX] = {
+	[TRACE_NONE]	 = "none",
+	[TRACE_RX_BURST] = "rx_burst",
+	[TRACE_TX_BURST] = "tx_burst",
+	[TRACE_DROP]	 = "drop",
+	[TRACE_FLOOD]	 = "flood",
+	[TRACE_VXLAN]	 = "vxlan",
+	[TRACE_TIMER]	 = "timer",
+};
+
+/* sem_post() is async-signal-safe, the dumper does the rest */
+static void
+trace_signal(int sig)
+{
+	sem_post(&trace_dump_sem);
+}
+
+static void *
+trace_dumper(void *arg)
+{
+	for (;;) {
+		if (sem_wait(&trace_dump_sem) == 0)
+			trace_dump(stderr);
+	}
+	return NULL;
+}
+
+/*
+ * Formats the dumps of SIGUSR1 on a thread of its own rather than on the
+ * dispatch lcore. The thread is moved off the CPUs of the lcores, as it
+ * inherits the affinity of the master.
+ */
+static int
+trace_dumper_start(void)
+{
+	long nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	pthread_t thread;
+	cpu_set_t cpus;
+	long cpu;
+
+	if (sem_init(&trace_dump_sem, 0, 0) != 0 ||
+	    pthread_create(&thread, NULL, trace_dumper, NULL) != 0) {
+		RTE_LOG(ERR, APP, "Cannot start the trace dumper\n");
+		return -1;
+	}
+	pthread_detach(thread);
+
+	CPU_ZERO(&cpus);
+	for (cpu = 0; cpu < nr_cpus && cpu < CPU_SETSIZE; cpu++) {
+		if (cpu >= RTE_MAX_LCORE || !rte_lcore_is_enabled(cpu))
+			CPU_SET(cpu, &cpus);
+	}
+	if (CPU_COUNT(&cpus) == 0 ||
+	    pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0)
+		RTE_LOG(WARNING, APP, "Trace dumps share the master CPU\n");
+
+	return 0;
+}
+
+int
+trace_init(int socket_id)
+{
+	const struct rte_memzone *mz;
+
+	mz = rte_memzone_reserve(TRACE_MZ_NAME, sizeof(*trace_shm),
+				 socket_id, 0);
+	if (mz == NULL) {
+		RTE_LOG(ERR, APP, "Cannot reserve trace memzone\n");
+		return -1;
+	}
+
+	trace_shm = mz->addr;
+	memset(trace_shm, 0, sizeof(*trace_shm));
+	trace_shm->hz = rte_get_tsc_hz();
+
+	if (trace_dumper_start() != 0)
+		return -1;
+	signal(SIGUSR1, trace_signal);
+
+	return 0;
+}
+
+int
+trace_attach(void)
+{
+	const struct rte_memzone *mz;
+
+	mz = rte_memzone_lookup(TRACE_MZ_NAME);
+	if (mz == NULL) {
+		RTE_LOG(ERR, APP, "Cannot find trace memzone\n");
+		return -1;
+	}
+
+	trace_shm = mz->addr;
+
+	return 0;
+}
+
+/*
+ * Prints the events of every lcore, oldest first, with their time
+ * relative to the last one. Events written while dumping may show torn.
+ */
+void
+trace_dump(FILE *f)
+{
+	struct trace_ring *ring;
+	struct trace_event e;
+	uint64_t head, i, last;
+	unsigned lcore;
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		ring = &trace_shm->rings[lcore];
+		head = ring->head;
+		if (head == 0)
+			continue;
+
+		rte_rmb();
+		last = ring->events[(head - 1) & TRACE_RING_MASK].tsc;
+
+		fprintf(f, "lcore %u: %"PRIu64" events\n", lcore, head);
+
+		i = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+		for (; i < head; i++) {
+			e = ring->events[i & TRACE_RING_MASK];
+			if (e.type >= TRACE_TYPE_MAX)
+				continue;
+
+			fprintf(f, "%12.3f us %-9s port %-3u sub %-3u %u\n",
+				-(double)(last - e.tsc) * 1e6 / trace_shm->hz,
+				trace_type_names[e.type], e.port, e.sub,
+				e.arg);
+		}
+	}
+	fflush(f);
+}
@@ -0,0 +1,104 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <rte_atomic.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+#include <rte_memory.h>
+
+/* Shared with secondary processes dumping the trace */
+#define TRACE_MZ_NAME		"lwip_dpdk_trace"
+
+/* Events kept per lcore, a power of 2 */
+#define TRACE_RING_SIZE		2048
+#define TRACE_RING_MASK		(TRACE_RING_SIZE - 1)
+
+typedef enum {
+	TRACE_NONE = 0,
+	TRACE_RX_BURST,		/* port, arg: packets */
+	TRACE_TX_BURST,		/* port, arg: packets */
+	TRACE_DROP,		/* port, sub: drop_reason, arg: packets */
+	TRACE_FLOOD,		/* port, sub: egress ports, arg: packets */
+	TRACE_VXLAN,		/* port, sub: peers, arg: packets */
+	TRACE_TIMER,		/* arg: timers fired */
+	TRACE_TYPE_MAX,
+} trace_type;
+
+struct trace_event {
+	uint64_t	 tsc;
+	uint8_t		 type;
+	uint8_t		 sub;
+	uint16_t	 port;
+	uint32_t	 arg;
+};
+
+/* written by its own lcore only, oldest events are overwritten */
+struct trace_ring {
+	volatile uint64_t	 head;
+	struct trace_event	 events[TRACE_RING_SIZE];
+} __rte_cache_aligned;
+
+struct trace_shm {
+	uint64_t		 hz;
+	struct trace_ring	 rings[RTE_MAX_LCORE];
+};
+
+extern struct trace_shm *trace_shm;
+
+static inline void
+trace(trace_type type, uint8_t sub, uint16_t port, uint32_t arg)
+{
+	struct trace_ring *ring = &trace_shm->rings[rte_lcore_id()];
+	struct trace_event *e = &ring->events[ring->head & TRACE_RING_MASK];
+
+	e->tsc = rte_rdtsc();
+	e->type = type;
+	e->sub = sub;
+	e->port = port;
+	e->arg = arg;
+
+	/* a reader sees the event before it moves past it */
+	rte_compiler_barrier();
+	ring->head++;
+}
+
+int trace_init(int socket_id);
+int trace_attach(void);
+void trace_dump(FILE *f);
+
+#endif
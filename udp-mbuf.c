@@ -0,0 +1,610 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+
+#include <lwip/inet_chksum.h>
+#include <lwip/ip.h>
+#include <lwip/udp.h>
+#include <netif/etharp.h>
+
+#include "convert.h"
+#include "ethif.h"
+#include "ipfrag.h"
+#include "kniif.h"
+#include "latency.h"
+#include "mempool.h"
+#include "pcb-hash.h"
+#include "plugif.h"
+#include "ringif.h"
+#include "tapif.h"
+#include "udp-mbuf.h"
+
+#define UDP_MBUF_HDR_LEN \
+	(sizeof(struct ether_hdr) + sizeof(struct ipv4_hdr) + \
+	 sizeof(struct udp_hdr))
+
+/* IANA dynamic range, as lwIP's udp_new_port() */
+#define UDP_MBUF_PORT_START	0xc000
+#define UDP_MBUF_PORT_END	0xffff
+
+/* lwIP's pcb list, defined in udp.c */
+extern struct udp_pcb *udp_pcbs;
+
+static int nr_socks;
+static uint64_t input_gen;
+static u16_t ip_id;
+
+/*
+ * Sockets are kept off udp_pcbs so that udp_input() walks lwIP's own
+ * pcbs only, the ports in use are therefore checked on both sides.
+ */
+static int
+udp_mbuf_port_used(ip_addr_t *ip_addr, u16_t port)
+{
+	struct udp_pcb *pcb;
+
+	for (pcb = udp_pcbs; pcb; pcb = pcb->next)
+		if (pcb->local_port == port &&
+		    (ip_addr_isany(&pcb->local_ip) || ip_addr_isany(ip_addr) ||
+		     ip_addr_cmp(&pcb->local_ip, ip_addr)))
+			return 1;
+
+	return pcb_hash_lookup(IP_PROTO_UDP, ip_addr->addr, port,
+			       IPADDR_ANY, 0) != NULL;
+}
+
+static u16_t
+udp_mbuf_new_port(ip_addr_t *ip_addr)
+{
+	static u16_t next = UDP_MBUF_PORT_START;
+	u32_t n;
+	u16_t port;
+
+	for (n = 0; n <= UDP_MBUF_PORT_END - UDP_MBUF_PORT_START; n++) {
+		port = next;
+		next = next == UDP_MBUF_PORT_END ?
+			UDP_MBUF_PORT_START : next + 1;
+		if (!udp_mbuf_port_used(ip_addr, port))
+			return port;
+	}
+	return 0;
+}
+
+struct udp_mbuf_sock *
+udp_mbuf_open(ip_addr_t *ip_addr, u16_t port,
+	      udp_mbuf_recv_fn recv, void *recv_arg)
+{
+	struct udp_mbuf_sock *sock;
+
+	if (ip_addr == NULL)
+		ip_addr = IP_ADDR_ANY;
+
+	if (port == 0)
+		port = udp_mbuf_new_port(ip_addr);
+	else if (udp_mbuf_port_used(ip_addr, port))
+		return NULL;
+	if (port == 0)
+		return NULL;
+
+	sock = rte_zmalloc("UDP_MBUF", sizeof(*sock), CACHE_LINE_SIZE);
+	if (sock == NULL)
+		return NULL;
+
+	ip_addr_copy(sock->ip_addr, *ip_addr);
+	sock->port = port;
+	sock->recv = recv;
+	sock->recv_arg = recv_arg;
+
+	/* the pcb only carries slow path sends, it is never bound */
+	ip_addr_copy(sock->pcb.local_ip, *ip_addr);
+	sock->pcb.local_port = port;
+	sock->pcb.ttl = UDP_TTL;
+
+	if (pcb_hash_add(IP_PROTO_UDP, &sock->ip_addr, sock->port,
+			 NULL, 0, sock) != 0) {
+		rte_free(sock);
+		return NULL;
+	}
+
+	nr_socks++;
+
+	return sock;
+}
+
+/*
+ * Restricts the socket to datagrams from ip_addr:port, which are then
+ * matched on the exact 4-tuple. As connect(2) on a UDP socket, the
+ * listening entry is replaced, so datagrams from other peers are no
+ * longer delivered to the socket; open another socket on the same port
+ * beforehand to keep receiving them.
+ */
+int
+udp_mbuf_connect(struct udp_mbuf_sock *sock, ip_addr_t *ip_addr, u16_t port)
+{
+	if (pcb_hash_add(IP_PROTO_UDP, &sock->ip_addr, sock->port,
+			 ip_addr, port, sock) != 0)
+		return -1;
+
+	pcb_hash_del(IP_PROTO_UDP, &sock->ip_addr, sock->port,
+		     &sock->remote_ip, sock->remote_port);
+
+	ip_addr_copy(sock->remote_ip, *ip_addr);
+	sock->remote_port = port;
+
+	return 0;
+}
+
+void
+udp_mbuf_close(struct udp_mbuf_sock *sock)
+{
+	pcb_hash_del(IP_PROTO_UDP, &sock->ip_addr, sock->port,
+		     &sock->remote_ip, sock->remote_port);
+	nr_socks--;
+
+	rte_free(sock);
+}
+
+/*
+ * Same algorithm as inet_chksum_pseudo() in lwIP, applied to the
+ * segments of an mbuf chain starting at off.
+ */
+static u16_t
+udp_mbuf_cksum(struct rte_mbuf *m, uint32_t off, u16_t len,
+	       u32_t src, u32_t dst)
+{
+	u32_t acc = 0;
+	u16_t udp_len = len;
+	int swapped = 0;
+	uint32_t n;
+	char *dat;
+
+	for (; m != NULL && len > 0; m = m->pkt.next) {
+		if (off >= rte_pktmbuf_data_len(m)) {
+			off -= rte_pktmbuf_data_len(m);
+			continue;
+		}
+		dat = rte_pktmbuf_mtod(m, char *) + off;
+		n = RTE_MIN((uint32_t)rte_pktmbuf_data_len(m) - off,
+			    (uint32_t)len);
+		off = 0;
+
+		acc += (u16_t)~inet_chksum(dat, n);
+		acc = FOLD_U32T(acc);
+		if (n % 2 != 0) {
+			swapped = 1 - swapped;
+			acc = SWAP_BYTES_IN_WORD(acc);
+		}
+		len -= n;
+	}
+
+	if (swapped)
+		acc = SWAP_BYTES_IN_WORD(acc);
+
+	acc += (src & 0xffffUL) + ((src >> 16) & 0xffffUL);
+	acc += (dst & 0xffffUL) + ((dst >> 16) & 0xffffUL);
+	acc += (u32_t)rte_cpu_to_be_16(IP_PROTO_UDP);
+	acc += (u32_t)rte_cpu_to_be_16(udp_len);
+
+	acc = FOLD_U32T(acc);
+	acc = FOLD_U32T(acc);
+
+	return (u16_t)~(acc & 0xffffUL);
+}
+
+/*
+ * The pseudo header sum a checksum offload completes, not inverted.
+ */
+static u16_t
+udp_mbuf_pseudo_cksum(u16_t udp_len, u32_t src, u32_t dst)
+{
+	u32_t acc = 0;
+
+	acc += (src & 0xffffUL) + ((src >> 16) & 0xffffUL);
+	acc += (dst & 0xffffUL) + ((dst >> 16) & 0xffffUL);
+	acc += (u32_t)rte_cpu_to_be_16(IP_PROTO_UDP);
+	acc += (u32_t)rte_cpu_to_be_16(udp_len);
+
+	acc = FOLD_U32T(acc);
+	acc = FOLD_U32T(acc);
+
+	return (u16_t)(acc & 0xffffUL);
+}
+
+/*
+ * Returns the socket a frame is destined to, or NULL if it has to go
+ * through lwIP. The frame is validated and its l2_len/l3_len are set.
+ */
+static struct udp_mbuf_sock *
+udp_mbuf_classify(struct netif *netif, struct rte_mbuf *m, int *drop)
+{
+	struct udp_mbuf_sock *sock;
+	struct ether_hdr *eth;
+	struct ipv4_hdr *ip;
+	struct udp_hdr *udp;
+	ip_addr_t dst;
+	uint32_t ip_len, hlen, pkt_len;
+
+	if (unlikely(rte_pktmbuf_data_len(m) <
+		     sizeof(*eth) + sizeof(*ip) + sizeof(*udp)))
+		return NULL;
+
+	eth = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	if (eth->ether_type != rte_cpu_to_be_16(ETHER_TYPE_IPv4))
+		return NULL;
+
+	ip = (struct ipv4_hdr *)(eth + 1);
+	if (ip->next_proto_id != IP_PROTO_UDP ||
+	    (ip->version_ihl >> 4) != 4 ||
+	    rte_ipv4_frag_pkt_is_fragmented(ip))
+		return NULL;
+
+	hlen = (ip->version_ihl & IPV4_HDR_IHL_MASK) * IPV4_IHL_MULTIPLIER;
+	if (unlikely(rte_pktmbuf_data_len(m) <
+		     sizeof(*eth) + hlen + sizeof(*udp)))
+		return NULL;
+
+	dst.addr = ip->dst_addr;
+	if (dst.addr != netif->ip_addr.addr &&
+	    !ip_addr_isbroadcast(&dst, netif))
+		return NULL;
+
+	udp = (struct udp_hdr *)((char *)ip + hlen);
+	sock = pcb_hash_lookup(IP_PROTO_UDP,
+			       dst.addr, rte_be_to_cpu_16(udp->dst_port),
+			       ip->src_addr, rte_be_to_cpu_16(udp->src_port));
+	if (sock == NULL)
+		return NULL;
+
+	/* from here the frame is ours, drop it if malformed */
+	*drop = 1;
+
+	ip_len = rte_be_to_cpu_16(ip->total_length);
+	pkt_len = rte_pktmbuf_pkt_len(m);
+	if (unlikely(ip_len < hlen + sizeof(*udp) ||
+		     pkt_len < sizeof(*eth) + ip_len ||
+		     rte_be_to_cpu_16(udp->dgram_len) != ip_len - hlen))
+		return sock;
+
+	if (unlikely(m->ol_flags & (PKT_RX_IP_CKSUM_BAD |
+				    PKT_RX_L4_CKSUM_BAD)))
+		return sock;
+
+	if (inet_chksum(ip, hlen) != 0)
+		return sock;
+
+	if (udp->dgram_cksum != 0 &&
+	    udp_mbuf_cksum(m, sizeof(*eth) + hlen, ip_len - hlen,
+			   ip->src_addr, ip->dst_addr) != 0)
+		return sock;
+
+	/* strip Ethernet padding */
+	if (pkt_len > sizeof(*eth) + ip_len) {
+		if (m->pkt.nb_segs != 1)
+			return sock;
+		rte_pktmbuf_trim(m, pkt_len - sizeof(*eth) - ip_len);
+	}
+
+	m->pkt.vlan_macip.f.l2_len = sizeof(*eth);
+	m->pkt.vlan_macip.f.l3_len = hlen;
+
+	*drop = 0;
+	return sock;
+}
+
+static void
+udp_mbuf_flush(struct udp_mbuf_sock *sock)
+{
+	uint32_t n_pkts = sock->nr_pending;
+
+	sock->nr_pending = 0;
+	sock->stats.rx_packets += n_pkts;
+	sock->recv(sock->recv_arg, sock, sock->pending, n_pkts);
+}
+
+/* buffer ownership and responsivity [input_burst]
+ *   mbuf: transfer the ownership of all datagrams destined to a socket
+ *         to its callback; the burst is compacted in place and the
+ *         number of frames left for lwIP is returned
+ */
+uint32_t
+udp_mbuf_input_burst(struct netif *netif,
+		     struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct udp_mbuf_sock *sock, *touched[n_pkts];
+	int nr_touched = 0;
+	uint32_t i, n = 0;
+	int drop, j;
+
+	if (likely(nr_socks == 0))
+		return n_pkts;
+
+	input_gen++;
+
+	for (i = 0; i < n_pkts; i++) {
+		drop = 0;
+		sock = udp_mbuf_classify(netif, pkts[i], &drop);
+		if (!sock) {
+			pkts[n++] = pkts[i];
+			continue;
+		}
+
+		if (unlikely(drop || !sock->recv)) {
+			rte_pktmbuf_free(pkts[i]);
+			sock->stats.rx_dropped += 1;
+			continue;
+		}
+
+		if (sock->input_gen != input_gen) {
+			sock->input_gen = input_gen;
+			touched[nr_touched++] = sock;
+		}
+
+		sock->pending[sock->nr_pending++] = pkts[i];
+		if (sock->nr_pending == UDP_MBUF_BURST_MAX)
+			udp_mbuf_flush(sock);
+	}
+
+	for (j = 0; j < nr_touched; j++) {
+		if (touched[j]->nr_pending > 0)
+			udp_mbuf_flush(touched[j]);
+	}
+
+	return n;
+}
+
+/* buffer ownership and responsivity [xmit]
+ *   mbuf: transfer the ownership of all mbuf to the port of netif
+ */
+static void
+udp_mbuf_xmit(struct netif *netif, struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_port_plug *plug_port;
+	uint32_t i;
+
+	switch (*(rte_port_type *)netif->state) {
+	case RTE_PORT_TYPE_ETH:
+		rte_port_eth_tx_burst(
+			&((struct ethif *)netif->state)->eth_port->rte_port,
+			pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_KNI:
+		rte_port_kni_tx_burst(
+			&((struct kniif *)netif->state)->kni_port->rte_port,
+			pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_RING:
+		rte_port_ring_tx_burst(
+			&((struct ringif *)netif->state)->ring_port->rte_port,
+			pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_TAP:
+		rte_port_tap_tx_burst(
+			&((struct tapif *)netif->state)->tap_port->rte_port,
+			pkts, n_pkts);
+		break;
+	case RTE_PORT_TYPE_PLUG:
+		plug_port = ((struct plugif *)netif->state)->plug_port;
+		if (plug_port->rx_burst) {
+			plug_port->rx_burst(plug_port, pkts, n_pkts);
+			break;
+		}
+		/* fall through */
+	default:
+		for (i = 0; i < n_pkts; i++)
+			rte_pktmbuf_free(pkts[i]);
+	}
+}
+
+/*
+ * Makes room for the headers in front of m. Data shared with clones or
+ * without enough headroom gets a separate header segment.
+ */
+static struct rte_mbuf *
+udp_mbuf_prepend(struct rte_mbuf *m, uint16_t len)
+{
+	struct rte_mbuf *h;
+
+	if (RTE_MBUF_INDIRECT(m) || rte_mbuf_refcnt_read(m) > 1 ||
+	    rte_pktmbuf_headroom(m) < len) {
+		h = rte_pktmbuf_alloc(pktmbuf_pool);
+		if (h == NULL)
+			return NULL;
+		h->pkt.next = m;
+		h->pkt.nb_segs = m->pkt.nb_segs + 1;
+		h->pkt.pkt_len = m->pkt.pkt_len;
+		m = h;
+	}
+
+	if (rte_pktmbuf_prepend(m, len) == NULL)
+		return NULL;
+
+	return m;
+}
+
+static int
+udp_mbuf_send_slow(struct udp_mbuf_sock *sock, ip_addr_t *ip_addr, u16_t port,
+		   struct rte_mbuf *m)
+{
+	struct pbuf *p;
+	err_t ret;
+
+	p = mbuf_to_pbuf(m);
+	rte_pktmbuf_free(m);
+	if (p == NULL)
+		return -1;
+
+	ret = udp_sendto(&sock->pcb, p, ip_addr, port);
+	pbuf_free(p);
+
+	return ret == ERR_OK ? 0 : -1;
+}
+
+/* buffer ownership and responsivity [send_burst]
+ *   mbuf: transfer the ownership of all mbuf sent successfully to
+ *         the underlying port, otherwise free all here
+ *
+ * Each mbuf holds the UDP payload only. Datagrams are sent through lwIP
+ * with a copy only while the next hop is not resolved yet.
+ */
+int
+udp_mbuf_send_burst(struct udp_mbuf_sock *sock,
+		    ip_addr_t *ip_addr, u16_t port,
+		    struct rte_mbuf **pkts, uint32_t n_pkts)
+{
+	struct rte_mbuf *m, *out[UDP_MBUF_BURST_MAX + IPFRAG_MAX_FRAGS];
+	struct netif *netif;
+	struct eth_addr *eth_ret = NULL;
+	ip_addr_t *ip_ret, *nexthop, *src;
+	struct ether_hdr *eth;
+	struct ipv4_hdr *ip;
+	struct udp_hdr *udp;
+	uint32_t i, n_out = 0, sent = 0;
+	uint16_t len;
+	int bcast, offload, n;
+
+	netif = ip_route(ip_addr);
+	if (netif == NULL)
+		goto drop;
+
+	/* the kernel behind a TAP port completes the UDP checksum */
+	offload = *(rte_port_type *)netif->state == RTE_PORT_TYPE_TAP;
+
+	bcast = ip_addr_isbroadcast(ip_addr, netif);
+	nexthop = ip_addr;
+	if (!bcast && !ip_addr_netcmp(ip_addr, &netif->ip_addr,
+				      &netif->netmask))
+		nexthop = &netif->gw;
+
+	if (!bcast &&
+	    etharp_find_addr(netif, nexthop, &eth_ret, &ip_ret) < 0) {
+		for (i = 0; i < n_pkts; i++) {
+			if (udp_mbuf_send_slow(sock, ip_addr, port,
+					       pkts[i]) == 0)
+				sent++;
+		}
+		sock->stats.tx_packets += sent;
+		sock->stats.tx_dropped += n_pkts - sent;
+		return sent;
+	}
+
+	src = ip_addr_isany(&sock->ip_addr) ? &netif->ip_addr : &sock->ip_addr;
+
+	for (i = 0; i < n_pkts; i++) {
+		len = rte_pktmbuf_pkt_len(pkts[i]);
+
+		m = udp_mbuf_prepend(pkts[i], UDP_MBUF_HDR_LEN);
+		if (m == NULL) {
+			rte_pktmbuf_free(pkts[i]);
+			sock->stats.tx_dropped += 1;
+			continue;
+		}
+
+		/* locally sent, or already accounted by the bridge */
+		mbuf_tsc_set(m, 0);
+
+		eth = rte_pktmbuf_mtod(m, struct ether_hdr *);
+		ip = (struct ipv4_hdr *)(eth + 1);
+		udp = (struct udp_hdr *)(ip + 1);
+
+		if (bcast)
+			memset(&eth->d_addr, 0xff, ETHER_ADDR_LEN);
+		else
+			rte_memcpy(&eth->d_addr, eth_ret->addr,
+				   ETHER_ADDR_LEN);
+		rte_memcpy(&eth->s_addr, netif->hwaddr, ETHER_ADDR_LEN);
+		eth->ether_type = rte_cpu_to_be_16(ETHER_TYPE_IPv4);
+
+		ip->version_ihl = 0x45;
+		ip->type_of_service = 0;
+		ip->total_length = rte_cpu_to_be_16(len + sizeof(*ip) +
+						    sizeof(*udp));
+		ip->packet_id = rte_cpu_to_be_16(ip_id++);
+		ip->fragment_offset = 0;
+		ip->time_to_live = UDP_TTL;
+		ip->next_proto_id = IP_PROTO_UDP;
+		ip->hdr_checksum = 0;
+		ip->src_addr = src->addr;
+		ip->dst_addr = ip_addr->addr;
+		ip->hdr_checksum = inet_chksum(ip, sizeof(*ip));
+
+		udp->src_port = rte_cpu_to_be_16(sock->port);
+		udp->dst_port = rte_cpu_to_be_16(port);
+		udp->dgram_len = rte_cpu_to_be_16(len + sizeof(*udp));
+		if (offload && len + sizeof(*ip) + sizeof(*udp) <= netif->mtu) {
+			udp->dgram_cksum = udp_mbuf_pseudo_cksum(
+				len + sizeof(*udp), ip->src_addr, ip->dst_addr);
+			m->ol_flags |= PKT_TX_UDP_CKSUM;
+			m->pkt.vlan_macip.f.l2_len = sizeof(*eth);
+			m->pkt.vlan_macip.f.l3_len = sizeof(*ip);
+		} else {
+			udp->dgram_cksum = 0;
+			udp->dgram_cksum = udp_mbuf_cksum(m,
+					sizeof(*eth) + sizeof(*ip),
+					len + sizeof(*udp),
+					ip->src_addr, ip->dst_addr);
+			if (udp->dgram_cksum == 0)
+				udp->dgram_cksum = 0xffff;
+		}
+
+		n = ipfrag_fragment(m, netif->mtu, &out[n_out],
+				    IPFRAG_MAX_FRAGS);
+		if (n < 0) {
+			sock->stats.tx_dropped += 1;
+			continue;
+		}
+		n_out += n;
+		sent++;
+
+		if (n_out >= UDP_MBUF_BURST_MAX) {
+			udp_mbuf_xmit(netif, out, n_out);
+			n_out = 0;
+		}
+	}
+
+	if (n_out > 0)
+		udp_mbuf_xmit(netif, out, n_out);
+
+	sock->stats.tx_packets += sent;
+	return sent;
+
+drop:
+	for (i = 0; i < n_pkts; i++)
+		rte_pktmbuf_free(pkts[i]);
+	sock->stats.tx_dropped += n_pkts;
+	return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _UDP_MBUF_H_
+#define _UDP_MBUF_H_
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include <lwip/ip_addr.h>
+#include <lwip/netif.h>
+#include <lwip/udp.h>
+
+/* Max number of datagrams delivered to a socket in one callback */
+#define UDP_MBUF_BURST_MAX	32
+
+struct udp_mbuf_sock;
+
+/* buffer ownership and responsivity [recv]
+ *   mbuf: transfer the ownership of all mbuf to the callback
+ *
+ * Each mbuf holds a whole frame starting at the Ethernet header; use
+ * udp_mbuf_payload_offset() to locate the UDP payload.
+ */
+typedef void (*udp_mbuf_recv_fn)
+	(void *arg, struct udp_mbuf_sock *sock,
+	 struct rte_mbuf **pkts, uint32_t n_pkts);
+
+struct udp_mbuf_stats {
+	uint64_t	rx_packets;
+	uint64_t	tx_packets;
+	uint64_t	rx_dropped;
+	uint64_t	tx_dropped;
+};
+
+struct udp_mbuf_sock {
+	ip_addr_t		 ip_addr;
+	u16_t			 port;
+	ip_addr_t		 remote_ip;
+	u16_t			 remote_port;
+	struct udp_pcb		 pcb;
+	udp_mbuf_recv_fn	 recv;
+	void			*recv_arg;
+	struct udp_mbuf_stats	 stats;
+	uint64_t		 input_gen;
+	uint32_t		 nr_pending;
+	struct rte_mbuf		*pending[UDP_MBUF_BURST_MAX];
+};
+
+struct udp_mbuf_sock * udp_mbuf_open(ip_addr_t *ip_addr, u16_t port,
+				     udp_mbuf_recv_fn recv, void *recv_arg);
+int udp_mbuf_connect(struct udp_mbuf_sock *sock,
+		     ip_addr_t *ip_addr, u16_t port);
+void udp_mbuf_close(struct udp_mbuf_sock *sock);
+int udp_mbuf_send_burst(struct udp_mbuf_sock *sock,
+			ip_addr_t *ip_addr, u16_t port,
+			struct rte_mbuf **pkts, uint32_t n_pkts);
+uint32_t udp_mbuf_input_burst(struct netif *netif,
+			      struct rte_mbuf **pkts, uint32_t n_pkts);
+
+static inline uint16_t
+udp_mbuf_payload_offset(struct rte_mbuf *m)
+{
+	return m->pkt.vlan_macip.f.l2_len + m->pkt.vlan_macip.f.l3_len +
+		sizeof(struct udp_hdr);
+}
+
+static inline void *
+udp_mbuf_payload(struct rte_mbuf *m)
+{
+	return rte_pktmbuf_mtod(m, char *) + udp_mbuf_payload_offset(m);
+}
+
+static inline uint16_t
+udp_mbuf_payload_len(struct rte_mbuf *m)
+{
+	return rte_pktmbuf_pkt_len(m) - udp_mbuf_payload_offset(m);
+}
+
+static inline void
+udp_mbuf_peer(struct rte_mbuf *m, ip_addr_t *ip_addr, u16_t *port)
+{
+	char *dat = rte_pktmbuf_mtod(m, char *) + m->pkt.vlan_macip.f.l2_len;
+	struct ipv4_hdr *ip = (struct ipv4_hdr *)dat;
+	struct udp_hdr *udp =
+		(struct udp_hdr *)(dat + m->pkt.vlan_macip.f.l3_len);
+
+	ip_addr->addr = ip->src_addr;
+	*port = rte_be_to_cpu_16(udp->src_port);
+}
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <rte_cycles.h>
+#include <rte_debug.h>
+
+#include "trace.h"
+#include "wheel.h"
+
+struct wheel wheels[RTE_MAX_LCORE];
+uint64_t wheel_tick_tsc;
+
+/*
+ * A hierarchical timer wheel in the way of the Linux kernel one: level 0
+ * has one slot per tick, each upper level slot covers a whole turn of
+ * the level below and is cascaded down when that level wraps around.
+ * One bitmap per level tells which slots are in use, so the next
+ * deadline is found without walking the slots.
+ */
+
+static void
+wheel_add(struct wheel *wheel, struct wheel_timer *timer)
+{
+	uint64_t expire = timer->expire;
+	uint64_t delta;
+	int level;
+
+	if (expire < wheel->tick)
+		expire = timer->expire = wheel->tick;
+
+	delta = expire - wheel->tick;
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (delta < (1ULL << (WHEEL_BITS * (level + 1))))
+			break;
+	}
+	if (level == WHEEL_LEVELS - 1 &&
+	    delta >= (1ULL << (WHEEL_BITS * WHEEL_LEVELS)))
+		expire = timer->expire =
+			wheel->tick + (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+	timer->level = level;
+	timer->slot = (expire >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	LIST_INSERT_HEAD(&wheel->slots[level][timer->slot], timer, next);
+	wheel->map[level] |= 1ULL << timer->slot;
+}
+
+static void
+wheel_del(struct wheel *wheel, struct wheel_timer *timer)
+{
+	LIST_REMOVE(timer, next);
+	if (LIST_EMPTY(&wheel->slots[timer->level][timer->slot]))
+		wheel->map[timer->level] &= ~(1ULL << timer->slot);
+}
+
+/* Returns the first tick that may have timers to run */
+static uint64_t
+wheel_next_tick(struct wheel *wheel)
+{
+	uint64_t map = wheel->map[0];
+	int idx = wheel->tick & WHEEL_MASK;
+	uint64_t next = UINT64_MAX;
+	int level;
+
+	if (map) {
+		map = idx ? (map >> idx) | (map << (WHEEL_SLOTS - idx)) : map;
+		next = wheel->tick + __builtin_ctzll(map);
+	}
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		if (wheel->map[level]) {
+			/* the next cascade may bring timers down, it runs
+			 * on tick itself when tick is on a wrap around
+			 */
+			next = RTE_MIN(next, idx ? wheel->tick +
+				       WHEEL_SLOTS - idx : wheel->tick);
+			break;
+		}
+	}
+	return next;
+}
+
+static void
+wheel_update(struct wheel *wheel)
+{
+	uint64_t next = wheel_next_tick(wheel);
+
+	wheel->next_tsc = next == UINT64_MAX ? UINT64_MAX :
+		next * wheel_tick_tsc;
+}
+
+static int
+wheel_cascade(struct wheel *wheel, int level)
+{
+	int idx = (wheel->tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	struct wheel_slot *slot = &wheel->slots[level][idx];
+	struct wheel_timer *timer;
+
+	while ((timer = LIST_FIRST(slot)) != NULL) {
+		LIST_REMOVE(timer, next);
+		wheel_add(wheel, timer);
+	}
+	wheel->map[level] &= ~(1ULL << idx);
+
+	return idx;
+}
+
+void
+wheel_run(struct wheel *wheel, uint64_t tsc)
+{
+	uint64_t now = tsc / wheel_tick_tsc;
+	struct wheel_slot *slot;
+	struct wheel_timer *timer;
+	uint32_t fired = 0;
+	int idx, level;
+
+	while (wheel->tick <= now) {
+		idx = wheel->tick & WHEEL_MASK;
+
+		/* nothing before the next wrap around, skip ahead */
+		if (idx && !wheel->map[0]) {
+			wheel->tick = RTE_MIN(now + 1,
+				(wheel->tick | WHEEL_MASK) + 1);
+			continue;
+		}
+
+		if (!idx) {
+			for (level = 1; level < WHEEL_LEVELS; level++) {
+				if (wheel_cascade(wheel, level) != 0)
+					break;
+			}
+		}
+
+		wheel->tick++;
+
+		slot = &wheel->slots[0][idx];
+		while ((timer = LIST_FIRST(slot)) != NULL) {
+			wheel_del(wheel, timer);
+
+			if (timer->period) {
+				timer->expire += timer->period;
+				wheel_add(wheel, timer);
+			} else {
+				timer->wheel = NULL;
+				wheel->nr_timers--;
+			}
+
+			timer->cb(timer, timer->arg);
+			fired++;
+		}
+	}
+
+	if (fired)
+		trace(TRACE_TIMER, 0, 0, fired);
+
+	wheel_update(wheel);
+}
+
+int
+wheel_init(void)
+{
+	uint64_t now;
+	unsigned lcore_id;
+	int level, slot;
+
+	wheel_tick_tsc = rte_get_tsc_hz() / (1000000 / WHEEL_TICK_US);
+	if (wheel_tick_tsc == 0)
+		return -1;
+
+	now = rte_rdtsc() / wheel_tick_tsc;
+
+	for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++) {
+		struct wheel *wheel = &wheels[lcore_id];
+
+		wheel->tick = now;
+		wheel->next_tsc = UINT64_MAX;
+		for (level = 0; level < WHEEL_LEVELS; level++)
+			for (slot = 0; slot < WHEEL_SLOTS; slot++)
+				LIST_INIT(&wheel->slots[level][slot]);
+	}
+	return 0;
+}
+
+void
+wheel_timer_init(struct wheel_timer *timer)
+{
+	memset(timer, 0, sizeof(*timer));
+}
+
+/*
+ * Arms the timer on the wheel of the calling lcore, which has to be the
+ * lcore that stops it. A pending timer is rearmed.
+ */
+void
+wheel_timer_start(struct wheel_timer *timer, uint32_t ms, uint32_t period_ms,
+		  wheel_timer_cb cb, void *arg)
+{
+	struct wheel *wheel = &wheels[rte_lcore_id()];
+	uint64_t now = rte_rdtsc() / wheel_tick_tsc;
+	uint64_t ticks = ((uint64_t)ms * 1000 + WHEEL_TICK_US - 1) /
+		WHEEL_TICK_US;
+
+	if (wheel_timer_pending(timer))
+		wheel_timer_stop(timer);
+
+	/* an empty wheel is not run, so it may lag behind */
+	if (wheel->nr_timers == 0)
+		wheel->tick = now;
+
+	timer->wheel = wheel;
+	timer->expire = now + ticks;
+	timer->period = ((uint64_t)period_ms * 1000 + WHEEL_TICK_US - 1) /
+		WHEEL_TICK_US;
+	timer->cb = cb;
+	timer->arg = arg;
+
+	wheel_add(wheel, timer);
+	wheel->nr_timers++;
+	wheel_update(wheel);
+}
+
+void
+wheel_timer_stop(struct wheel_timer *timer)
+{
+	struct wheel *wheel = timer->wheel;
+
+	if (!wheel)
+		return;
+
+	RTE_VERIFY(wheel == &wheels[rte_lcore_id()]);
+
+	wheel_del(wheel, timer);
+	wheel->nr_timers--;
+	timer->wheel = NULL;
+	wheel_update(wheel);
+}
@@ -0,0 +1,105 @@
+/*
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2014 Midokura SARL.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Midokura SARL nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef _WHEEL_H_
+#define _WHEEL_H_
+
+#include <stdint.h>
+#include <sys/queue.h>
+
+#include <rte_lcore.h>
+#include <rte_memory.h>
+
+/* Resolution of the timer wheel */
+#define WHEEL_TICK_US		1000
+
+/* Four levels of 64 slots cover 2^24 ticks (about 4.6 hours) */
+#define WHEEL_BITS		6
+#define WHEEL_SLOTS		(1 << WHEEL_BITS)
+#define WHEEL_MASK		(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS		4
+
+struct wheel_timer;
+
+typedef void (*wheel_timer_cb)(struct wheel_timer *timer, void *arg);
+
+LIST_HEAD(wheel_slot, wheel_timer);
+
+struct wheel_timer {
+	LIST_ENTRY(wheel_timer)	 next;
+	struct wheel		*wheel;
+	uint64_t		 expire;	/* in ticks */
+	uint32_t		 period;	/* in ticks, 0 if one shot */
+	int			 level;
+	int			 slot;
+	wheel_timer_cb		 cb;
+	void			*arg;
+};
+
+struct wheel {
+	uint64_t		 tick;		/* next tick to run */
+	uint64_t		 next_tsc;	/* when to run next */
+	uint32_t		 nr_timers;
+	uint64_t		 map[WHEEL_LEVELS];
+	struct wheel_slot	 slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} __rte_cache_aligned;
+
+extern struct wheel wheels[RTE_MAX_LCORE];
+extern uint64_t wheel_tick_tsc;
+
+int wheel_init(void);
+void wheel_timer_init(struct wheel_timer *timer);
+void wheel_timer_start(struct wheel_timer *timer, uint32_t ms,
+		       uint32_t period_ms, wheel_timer_cb cb, void *arg);
+void wheel_timer_stop(struct wheel_timer *timer);
+void wheel_run(struct wheel *wheel, uint64_t tsc);
+
+static inline int
+wheel_timer_pending(struct wheel_timer *timer)
+{
+	return timer->wheel != NULL;
+}
+
+/*
+ * To be called from the main loop of each lcore. Cheap until the
+ * earliest deadline of the lcore's wheel is due.
+ */
+static inline void
+wheel_poll(uint64_t tsc)
+{
+	struct wheel *wheel = &wheels[rte_lcore_id()];
+
+	if (unlikely(tsc >= wheel->next_tsc))
+		wheel_run(wheel, tsc);
+}
+
+#endif